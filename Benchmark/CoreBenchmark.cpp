@@ -0,0 +1,628 @@
+//
+// AirPodsDesktop - AirPods Desktop User Experience Enhancement Program.
+// Copyright (C) 2021-2022 SpriteOvO
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <atomic>
+#include <random>
+#include <vector>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+#include <thread>
+#include <benchmark/benchmark.h>
+
+#include "Core/AirPods.h"
+#include "Core/AppleCP.h"
+#include "Core/AppleCPBatch.h"
+#include "Core/BatteryHistory.h"
+
+using namespace Core;
+
+//////////////////////////////////////////////////
+// Allocation counting
+//
+
+namespace {
+std::atomic<uint64_t> gAllocations{0};
+} // namespace
+
+// The counting allocation functions must not be inlined, otherwise GCC sees `malloc` paired with
+// `delete` at the call sites and warns about mismatched allocation functions
+//
+#if defined _MSC_VER
+    #define APD_BENCHMARK_NOINLINE __declspec(noinline)
+#else
+    #define APD_BENCHMARK_NOINLINE [[gnu::noinline]]
+#endif
+
+APD_BENCHMARK_NOINLINE void *operator new(size_t size)
+{
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+APD_BENCHMARK_NOINLINE void *operator new(size_t size, std::align_val_t alignment)
+{
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+
+    const auto align = static_cast<size_t>(alignment);
+#if defined _MSC_VER
+    void *ptr = _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+    // The size of `aligned_alloc` must be a multiple of the alignment
+    void *ptr = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align);
+#endif
+    if (ptr != nullptr) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+APD_BENCHMARK_NOINLINE void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+APD_BENCHMARK_NOINLINE void operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+APD_BENCHMARK_NOINLINE void operator delete(void *ptr, std::align_val_t) noexcept
+{
+#if defined _MSC_VER
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+APD_BENCHMARK_NOINLINE void operator delete(void *ptr, size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(ptr, alignment);
+}
+
+namespace {
+
+class PerAdvCounters
+{
+public:
+    PerAdvCounters(benchmark::State &state) : _state{state}
+    {
+        _allocationsBegin = gAllocations.load(std::memory_order_relaxed);
+    }
+
+    ~PerAdvCounters()
+    {
+        const auto allocations = gAllocations.load(std::memory_order_relaxed) - _allocationsBegin;
+
+        _state.SetItemsProcessed(_state.iterations());
+        _state.counters["time/adv"] = benchmark::Counter(
+            static_cast<double>(_state.iterations()),
+            benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+        _state.counters["allocs/adv"] = benchmark::Counter(
+            static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    benchmark::State &_state;
+    uint64_t _allocationsBegin;
+};
+
+//////////////////////////////////////////////////
+// Packet generation
+//
+
+using ReceivedData = Bluetooth::AdvertisementWatcher::ReceivedData;
+
+struct PacketDesc {
+    uint16_t modelId{0x2014};
+    AirPods::Side side{AirPods::Side::Left};
+    uint8_t left{8}, right{8}, caseBox{6};
+    bool lidClosed{true};
+};
+
+std::vector<uint8_t> MakePayload(const PacketDesc &desc)
+{
+    std::vector<uint8_t> payload(sizeof(AppleCP::AirPods), 0);
+
+    const bool fromLeft = desc.side == AirPods::Side::Left;
+
+    payload[0] = Helper::ToUnderlying(AppleCP::PacketType::ProximityPairing);
+    payload[1] = sizeof(AppleCP::AirPods) - sizeof(AppleCP::Header);
+    payload[2] = 0x01;
+    payload[3] = desc.modelId & 0xFF;
+    payload[4] = desc.modelId >> 8;
+    payload[5] = fromLeft ? 0x20 : 0x00;
+    payload[6] = fromLeft ? (desc.left | desc.right << 4) : (desc.right | desc.left << 4);
+    payload[7] = desc.caseBox;
+    payload[8] = desc.lidClosed ? 0x08 : 0x00;
+    return payload;
+}
+
+ReceivedData MakeReceivedData(const PacketDesc &desc, uint64_t address, int16_t rssi)
+{
+    ReceivedData data;
+    data.rssi = rssi;
+    data.address = address;
+    data.manufacturerDataMap.try_emplace(AppleCP::VendorId, MakePayload(desc));
+    return data;
+}
+
+enum class Mix : int64_t {
+    Steady,   // Our left and right pods only, fixed addresses
+    Foreign,  // Half of the packets are from another AirPods nearby
+    Rotation, // Our pods, the addresses rotate every 64 packets
+};
+
+std::vector<ReceivedData> MakeStream(Mix mix, size_t count)
+{
+    std::vector<ReceivedData> result;
+    result.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        PacketDesc desc;
+        desc.side = i % 2 == 0 ? AirPods::Side::Left : AirPods::Side::Right;
+
+        uint64_t address = desc.side == AirPods::Side::Left ? 0x1111 : 0x2222;
+        int16_t rssi = -50 - static_cast<int16_t>(i % 5);
+
+        switch (mix) {
+        case Mix::Steady:
+            break;
+        case Mix::Foreign:
+            if (i % 4 >= 2) {
+                desc.modelId = 0x200E;
+                desc.left = desc.right = 3;
+                address += 0x10000;
+                rssi = -70;
+            }
+            break;
+        case Mix::Rotation:
+            address += (i / 64) << 16;
+            break;
+        }
+
+        result.push_back(MakeReceivedData(desc, address, rssi));
+    }
+    return result;
+}
+
+// Payloads of many devices, as in a captured stream
+//
+std::vector<AppleCP::Batch::Payload> MakePayloads(size_t count)
+{
+    std::mt19937 rng{2022};
+    std::uniform_int_distribution<int> batteryDist{0, 10};
+    std::bernoulli_distribution boolDist{0.5};
+
+    std::vector<AppleCP::Batch::Payload> result(count);
+    for (auto &payload : result) {
+        PacketDesc desc{
+            .side = boolDist(rng) ? AirPods::Side::Left : AirPods::Side::Right,
+            .left = static_cast<uint8_t>(batteryDist(rng)),
+            .right = static_cast<uint8_t>(batteryDist(rng)),
+            .caseBox = static_cast<uint8_t>(batteryDist(rng)),
+            .lidClosed = boolDist(rng)};
+
+        const auto bytes = MakePayload(desc);
+        std::copy(bytes.begin(), bytes.end(), payload.begin());
+    }
+    return result;
+}
+
+// A crowded place, our AirPods and `foreignCount` AirPods of the same model nearby, all of them
+// rotate their addresses. Timestamps are simulated so that the replay doesn't depend on the speed.
+//
+struct ReplayPacket {
+    ReceivedData data;
+    AirPods::Details::Advertisement::Timestamp timestamp;
+    bool isOurs;
+};
+
+std::vector<ReplayPacket> MakeReplay(size_t foreignCount, size_t count)
+{
+    struct Device {
+        uint8_t left, right, caseBox;
+        int16_t rssiMean;
+        uint64_t addressBase{0};
+        size_t sent{0};
+    };
+
+    std::mt19937 rng{2022};
+    std::normal_distribution<float> rssiNoise{0.f, 4.f};
+    std::uniform_int_distribution<int> batteryDist{3, 10};
+    std::uniform_int_distribution<int> rssiMeanDist{-78, -60};
+
+    std::vector<Device> devices;
+    devices.push_back(Device{.left = 8, .right = 8, .caseBox = 6, .rssiMean = -55});
+    for (size_t i = 0; i < foreignCount; ++i) {
+        devices.push_back(Device{
+            .left = static_cast<uint8_t>(batteryDist(rng)),
+            .right = static_cast<uint8_t>(batteryDist(rng)),
+            .caseBox = static_cast<uint8_t>(batteryDist(rng)),
+            .rssiMean = static_cast<int16_t>(rssiMeanDist(rng))});
+    }
+    for (size_t i = 0; i < devices.size(); ++i) {
+        devices[i].addressBase = (i + 1) << 32;
+    }
+
+    constexpr size_t kRotationInterval = 2000; // Packets of a device between address rotations
+    constexpr auto kPacketInterval = std::chrono::milliseconds{10};
+
+    std::uniform_int_distribution<size_t> deviceDist{0, devices.size() - 1};
+    std::bernoulli_distribution sideDist{0.5};
+
+    std::vector<ReplayPacket> result;
+    result.reserve(count);
+
+    AirPods::Details::Advertisement::Timestamp timestamp{};
+
+    for (size_t i = 0; i < count; ++i) {
+        const auto deviceIndex = deviceDist(rng);
+        auto &device = devices[deviceIndex];
+
+        // Our batteries drain slowly
+        //
+        if (deviceIndex == 0 && device.sent != 0 && device.sent % 3000 == 0) {
+            device.left = std::max(device.left - 1, 1);
+            device.right = std::max(device.right - 1, 1);
+        }
+
+        PacketDesc desc{
+            .side = sideDist(rng) ? AirPods::Side::Left : AirPods::Side::Right,
+            .left = device.left,
+            .right = device.right,
+            .caseBox = device.caseBox,
+        };
+
+        const uint64_t rotation = device.sent / kRotationInterval;
+        const uint64_t address =
+            device.addressBase | rotation << 1 | (desc.side == AirPods::Side::Left ? 0 : 1);
+        const auto rssi = static_cast<int16_t>(device.rssiMean + rssiNoise(rng));
+
+        timestamp += kPacketInterval;
+        result.push_back(ReplayPacket{
+            .data = MakeReceivedData(desc, address, rssi),
+            .timestamp = timestamp,
+            .isOurs = deviceIndex == 0});
+
+        device.sent += 1;
+    }
+    return result;
+}
+
+//////////////////////////////////////////////////
+// Benchmarks
+//
+
+void BM_AppleCP_As(benchmark::State &state)
+{
+    const auto payload = MakePayload({});
+
+    PerAdvCounters counters{state};
+    for (auto _ : state) {
+        auto protocol = AppleCP::As<AppleCP::AirPods>(payload);
+        benchmark::DoNotOptimize(protocol);
+    }
+}
+BENCHMARK(BM_AppleCP_As);
+
+// The per-object accessors into the same structure of arrays, the baseline of the batch decoder
+//
+void DecodePerObject(
+    std::span<const AppleCP::Batch::Payload> payloads, AppleCP::Batch::Decoded &output)
+{
+    const auto size = payloads.size();
+
+    output.model.resize(size);
+    output.leftBattery.resize(size);
+    output.rightBattery.resize(size);
+    output.caseBattery.resize(size);
+    output.charging.resize(size);
+    output.inEar.resize(size);
+    output.lidOpened.resize(size);
+
+    const auto encode = [](const AirPods::Battery &battery) {
+        return static_cast<uint8_t>(battery.Available() ? battery.Value() : 0x0F);
+    };
+
+    for (size_t i = 0; i < size; ++i) {
+        const auto &airPods = **AppleCP::ViewAs<AppleCP::AirPods>(payloads[i]);
+
+        output.model[i] = airPods.GetModel();
+        output.leftBattery[i] = encode(airPods.GetLeftBattery());
+        output.rightBattery[i] = encode(airPods.GetRightBattery());
+        output.caseBattery[i] = encode(airPods.GetCaseBattery());
+        output.charging[i] = airPods.IsLeftCharging() * AppleCP::Batch::Bit::Left |
+                             airPods.IsRightCharging() * AppleCP::Batch::Bit::Right |
+                             airPods.IsCaseCharging() * AppleCP::Batch::Bit::Case;
+        output.inEar[i] = airPods.IsLeftInEar() * AppleCP::Batch::Bit::Left |
+                          airPods.IsRightInEar() * AppleCP::Batch::Bit::Right;
+        output.lidOpened[i] = airPods.IsLidOpened();
+    }
+}
+
+template <bool kBatch>
+void BM_AppleCP_DecodeMany(benchmark::State &state)
+{
+    const auto payloads = MakePayloads(static_cast<size_t>(state.range(0)));
+
+    AppleCP::Batch::Decoded decoded;
+
+    for (auto _ : state) {
+        if constexpr (kBatch) {
+            AppleCP::Batch::Decode(payloads, decoded);
+        }
+        else {
+            DecodePerObject(payloads, decoded);
+        }
+        benchmark::DoNotOptimize(decoded.leftBattery.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * payloads.size());
+}
+BENCHMARK(BM_AppleCP_DecodeMany<false>)->Name("BM_AppleCP_PerObjectDecode")->Arg(4096);
+BENCHMARK(BM_AppleCP_DecodeMany<true>)->Name("BM_AppleCP_BatchDecode")->Arg(4096);
+
+void BM_Advertisement_Decode(benchmark::State &state)
+{
+    const auto data = MakeReceivedData({}, 0x1111, -50);
+
+    PerAdvCounters counters{state};
+    for (auto _ : state) {
+        auto adv = AirPods::Details::Advertisement::Decode(data);
+        benchmark::DoNotOptimize(adv);
+    }
+}
+BENCHMARK(BM_Advertisement_Decode);
+
+// The steady-state path of `Manager::OnAdvertisementReceived`, decoding and state update
+//
+void BM_StateManager_OnAdvReceived(benchmark::State &state)
+{
+    const auto stream = MakeStream(static_cast<Mix>(state.range(0)), 1024);
+
+    AirPods::Details::StateManager stateMgr;
+    stateMgr.OnRssiMinChanged(-80);
+
+    size_t index = 0;
+
+    PerAdvCounters counters{state};
+    for (auto _ : state) {
+        auto adv = AirPods::Details::Advertisement::Decode(stream[index]);
+        if (!stateMgr.OnRepeatedAdvReceived(adv.value())) {
+            auto event = stateMgr.OnAdvReceived(adv.value());
+            benchmark::DoNotOptimize(event);
+        }
+
+        index = (index + 1) % stream.size();
+    }
+}
+BENCHMARK(BM_StateManager_OnAdvReceived)
+    ->ArgName("mix")
+    ->Arg(Helper::ToUnderlying(Mix::Steady))
+    ->Arg(Helper::ToUnderlying(Mix::Foreign))
+    ->Arg(Helper::ToUnderlying(Mix::Rotation));
+
+// Batching mode, a window is simulated by flushing every `range(1)` advertisements
+//
+void BM_StateManager_Batched(benchmark::State &state)
+{
+    const auto stream = MakeStream(static_cast<Mix>(state.range(0)), 1024);
+    const auto window = static_cast<size_t>(state.range(1));
+
+    AirPods::Details::StateManager stateMgr;
+    stateMgr.OnRssiMinChanged(-80);
+    stateMgr.SetBatching(true);
+
+    size_t index = 0;
+
+    PerAdvCounters counters{state};
+    for (auto _ : state) {
+        auto adv = AirPods::Details::Advertisement::Decode(stream[index]);
+        if (!stateMgr.OnRepeatedAdvReceived(adv.value())) {
+            stateMgr.OnAdvReceived(adv.value());
+        }
+        if (index % window == 0) {
+            auto event = stateMgr.Flush();
+            benchmark::DoNotOptimize(event);
+        }
+
+        index = (index + 1) % stream.size();
+    }
+}
+BENCHMARK(BM_StateManager_Batched)
+    ->ArgNames({"mix", "window"})
+    ->Args({Helper::ToUnderlying(Mix::Foreign), 16})
+    ->Args({Helper::ToUnderlying(Mix::Rotation), 16});
+
+// Reports how well the tracker picks our advertisements out of a crowd. Our AirPods are at -55 dBm
+// on average, so a `rssi_min` of -60 would drop about 10% of them if it was applied per packet.
+//
+void BM_DeviceTracker_Replay(benchmark::State &state)
+{
+    const auto replay = MakeReplay(static_cast<size_t>(state.range(0)), 20000);
+    const auto rssiMin = static_cast<int16_t>(state.range(1));
+
+    std::vector<AirPods::Details::Advertisement> advs;
+    advs.reserve(replay.size());
+    for (const auto &packet : replay) {
+        advs.push_back(
+            AirPods::Details::Advertisement::Decode(packet.data, packet.timestamp).value());
+    }
+
+    uint64_t ours = 0, accepted = 0, oursAccepted = 0;
+
+    for (auto _ : state) {
+        AirPods::Details::DeviceTracker tracker;
+        tracker.OnRssiMinChanged(rssiMin);
+
+        for (size_t i = 0; i < advs.size(); ++i) {
+            const bool isAccepted = tracker.Feed(advs[i]);
+
+            ours += replay[i].isOurs;
+            accepted += isAccepted;
+            oursAccepted += isAccepted && replay[i].isOurs;
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * advs.size());
+    state.counters["time/adv"] = benchmark::Counter(
+        static_cast<double>(state.iterations() * advs.size()),
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["precision"] =
+        static_cast<double>(oursAccepted) / static_cast<double>(std::max<uint64_t>(accepted, 1));
+    state.counters["recall"] =
+        static_cast<double>(oursAccepted) / static_cast<double>(std::max<uint64_t>(ours, 1));
+}
+BENCHMARK(BM_DeviceTracker_Replay)
+    ->ArgNames({"foreign", "rssi_min"})
+    ->Args({0, -100})
+    ->Args({3, -100})
+    ->Args({10, -100})
+    ->Args({10, -60});
+
+void BM_StateManager_GetSnapshot(benchmark::State &state)
+{
+    AirPods::Details::StateManager stateMgr;
+    stateMgr.OnRssiMinChanged(-80);
+    const auto updateEvent = stateMgr.OnAdvReceived(
+        AirPods::Details::Advertisement::Decode(MakeReceivedData({}, 0x1111, -50)).value());
+    if (updateEvent.has_value()) {
+        stateMgr.PublishState(updateEvent->newState);
+    }
+
+    for (auto _ : state) {
+        auto snapshot = stateMgr.GetSnapshot();
+        benchmark::DoNotOptimize(snapshot->version);
+    }
+}
+BENCHMARK(BM_StateManager_GetSnapshot);
+
+void BM_Callback_Invoke(benchmark::State &state)
+{
+    Helper::Callback<Bluetooth::AdvertisementWatcher::FnReceived> callback;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        callback += [](const ReceivedData &data) { benchmark::DoNotOptimize(data.rssi); };
+    }
+
+    const auto data = MakeReceivedData({}, 0x1111, -50);
+
+    PerAdvCounters counters{state};
+    for (auto _ : state) {
+        callback.Invoke(data);
+    }
+}
+BENCHMARK(BM_Callback_Invoke)->ArgName("listeners")->Arg(1)->Arg(4)->Arg(16);
+
+// Appending to the memory-mapped ring buffer, which wraps around many times here
+//
+void BM_BatteryHistory_Append(benchmark::State &state)
+{
+    const auto path = std::filesystem::temp_directory_path() / "ApdBenchmarkBatteryHistory.bin";
+
+    BatteryHistory::History history;
+    if (!history.Open(path, 1024)) {
+        state.SkipWithError("Open battery history failed.");
+        return;
+    }
+
+    BatteryHistory::Sample sample{
+        .time = BatteryHistory::Clock::now(),
+        .key = 0x1111,
+        .left = 80,
+        .right = 70,
+        .caseBox = 50,
+        .charging = BatteryHistory::Bit::Case};
+
+    PerAdvCounters counters{state};
+    for (auto _ : state) {
+        history.Append(sample);
+        sample.time += std::chrono::seconds{1};
+    }
+
+    history.Close();
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_BatteryHistory_Append);
+
+#if defined APD_OS_LINUX && !defined APD_BLUETOOTH_HCI
+// Throughput of the BlueZ advertisement path, from the `PropertiesChanged` signals to
+// `CbReceived`. It needs the mock BlueZ of "bluez_mock_adverts.py", which runs this benchmark with
+// `APD_BLUEZ_MOCK` set to the path of the device it floods with advertisements.
+//
+void BM_AdvertisementWatcher_BlueZ(benchmark::State &state)
+{
+    constexpr uint32_t kAdvsPerIteration = 10000;
+    constexpr auto kTimeout = std::chrono::seconds{10};
+
+    const std::string devicePath = std::getenv("APD_BLUEZ_MOCK");
+
+    std::atomic<uint64_t> received{0};
+
+    Bluetooth::AdvertisementWatcher watcher;
+    watcher.CbReceived() += [&](const ReceivedData &) {
+        received.fetch_add(1, std::memory_order_relaxed);
+    };
+    if (!watcher.Start()) {
+        state.SkipWithError("Start AdvertisementWatcher failed.");
+        return;
+    }
+
+    // Flooded from another connection, so the signals queue up while the mock is emitting them
+    //
+    auto connection = sdbus::createSystemBusConnection();
+    auto mock = sdbus::createProxy(*connection, "org.bluez", "/");
+
+    uint64_t expected = 0;
+    for (auto _ : state) {
+        mock->callMethod("Flood")
+            .onInterface("org.freedesktop.DBus.Mock")
+            .withArguments(devicePath, kAdvsPerIteration);
+        expected += kAdvsPerIteration;
+
+        const auto deadline = std::chrono::steady_clock::now() + kTimeout;
+        while (received.load(std::memory_order_relaxed) < expected) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                state.SkipWithError("Advertisements are lost.");
+                break;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    watcher.Stop();
+    state.SetItemsProcessed(static_cast<int64_t>(received.load()));
+}
+
+[[maybe_unused]] const auto *kBluezBenchmark =
+    std::getenv("APD_BLUEZ_MOCK") == nullptr
+        ? nullptr
+        : benchmark::RegisterBenchmark(
+              "BM_AdvertisementWatcher_BlueZ", &BM_AdvertisementWatcher_BlueZ)
+              ->UseRealTime()
+              ->Unit(benchmark::kMillisecond);
+#endif
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+#
+# AirPodsDesktop - AirPods Desktop User Experience Enhancement Program.
+# Copyright (C) 2021-2022 SpriteOvO
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+"""Measures the advertisements per second of the BlueZ AdvertisementWatcher.
+
+Starts a private system bus with a mock BlueZ, an adapter and an AirPods device, and runs
+`BM_AdvertisementWatcher_BlueZ` of the benchmark against it. The benchmark floods the device with
+`PropertiesChanged` signals carrying `RSSI` and `ManufacturerData`, the same as bluetoothd does
+during discovery with `DuplicateData`, and reports the received ones as `items_per_second`.
+
+Requires python-dbusmock and dbus-daemon, and a Linux build with `APD_BUILD_TESTS` on:
+
+    python3 Benchmark/bluez_mock_adverts.py <BuildPath>/AirPodsDesktopBenchmark [benchmark args]
+
+The mock emits the signals from Python, so if `items_per_second` is close to the rate the mock
+prints, the watcher keeps up and the mock is the bottleneck.
+
+This file is also the dbusmock template of the mock BlueZ.
+"""
+
+import os
+import subprocess
+import sys
+import time
+
+import dbus
+import dbus.lowlevel
+import dbus.service
+import dbusmock
+from dbusmock import MOCK_IFACE, OBJECT_MANAGER_IFACE
+
+BUS_NAME = 'org.bluez'
+MAIN_OBJ = '/'
+MAIN_IFACE = OBJECT_MANAGER_IFACE
+SYSTEM_BUS = True
+
+ADAPTER_PATH = '/org/bluez/hci0'
+DEVICE_PATH = ADAPTER_PATH + '/dev_11_22_33_44_55_66'
+
+ADAPTER_IFACE = 'org.bluez.Adapter1'
+DEVICE_IFACE = 'org.bluez.Device1'
+PROPERTIES_IFACE = 'org.freedesktop.DBus.Properties'
+
+APPLE_COMPANY_ID = 0x004C
+
+# A proximity pairing message of AirPods Pro, both pods in the case with the lid opened
+PROXIMITY_PAIRING = bytes.fromhex('0719010e2055aa5531000000000000000000000000000000000000')
+
+
+#
+# Template
+#
+
+def load(mock, parameters):
+    mock.AddObject(ADAPTER_PATH, ADAPTER_IFACE, {
+        'Address': dbus.String('00:11:22:33:44:55'),
+        'Powered': dbus.Boolean(True),
+        'Discovering': dbus.Boolean(False),
+    }, [
+        ('SetDiscoveryFilter', 'a{sv}', '', ''),
+        ('StartDiscovery', '', '', 'self.Set("%s", "Discovering", True)' % ADAPTER_IFACE),
+        ('StopDiscovery', '', '', 'self.Set("%s", "Discovering", False)' % ADAPTER_IFACE),
+    ])
+
+    mock.AddObject(DEVICE_PATH, DEVICE_IFACE, {
+        'Address': dbus.String('11:22:33:44:55:66'),
+        'Name': dbus.String('AirPods Pro'),
+        'Modalias': dbus.String('bluetooth:v004Cp200Ed0100'),
+        'Paired': dbus.Boolean(True),
+        'Connected': dbus.Boolean(True),
+    }, [])
+
+
+# Emits the signals directly on the connection, `EmitSignal` would log each of them
+#
+@dbus.service.method(MOCK_IFACE, in_signature='su', out_signature='')
+def Flood(self, path, count):
+    data = dbus.Array(PROXIMITY_PAIRING, signature='y', variant_level=1)
+    for i in range(count):
+        message = dbus.lowlevel.SignalMessage(path, PROPERTIES_IFACE, 'PropertiesChanged')
+        message.append(
+            DEVICE_IFACE,
+            dbus.Dictionary({
+                'RSSI': dbus.Int16(-40 - i % 20, variant_level=1),
+                'ManufacturerData': dbus.Dictionary(
+                    {dbus.UInt16(APPLE_COMPANY_ID): data}, signature='qv', variant_level=1),
+            }, signature='sv'),
+            dbus.Array([], signature='s'),
+            signature='sa{sv}as')
+        self.connection.send_message(message)
+
+
+#
+# Runner
+#
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit('Usage: %s <benchmark executable> [benchmark args]' % sys.argv[0])
+
+    dbusmock.DBusTestCase.start_system_bus()
+    server, _ = dbusmock.DBusTestCase.spawn_server_template(
+        os.path.abspath(__file__), {}, subprocess.DEVNULL)
+
+    try:
+        mock = dbus.Interface(
+            dbus.SystemBus().get_object(BUS_NAME, MAIN_OBJ), dbus_interface=MOCK_IFACE)
+
+        count = 10000
+        begin = time.perf_counter()
+        mock.Flood(DEVICE_PATH, count)
+        print('The mock emits %.0f advertisements per second.' %
+              (count / (time.perf_counter() - begin)))
+
+        env = dict(os.environ, APD_BLUEZ_MOCK=DEVICE_PATH)
+        result = subprocess.run(
+            [sys.argv[1], '--benchmark_filter=BM_AdvertisementWatcher_BlueZ', *sys.argv[2:]],
+            env=env)
+        return result.returncode
+    finally:
+        server.terminate()
+        server.wait()
+        dbusmock.DBusTestCase.tearDownClass()
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -23,6 +23,7 @@
 #include <Config.h>
 // #include "Logger.h"
 #include "Error.h"
+#include "Utils.h"
 #include "Core/Bluetooth.h"
 #include "Core/GlobalMedia.h"
 #include "Core/Settings.h"
@@ -163,7 +164,12 @@ bool ApdApplication::Prepare(int argc, char *argv[])
 
 int ApdApplication::Run()
 {
-    _mainWindow->GetApdMgr().StartScanner();
+    auto &apdMgr = _mainWindow->GetApdMgr();
+
+    const auto workspace = Utils::File::GetWorkspace();
+    apdMgr.OpenBatteryHistory(workspace.absoluteFilePath("BatteryHistory.bin").toStdWString());
+
+    apdMgr.StartScanner();
     return exec();
 }
 
@@ -21,117 +21,559 @@
 #include <mutex>
 #include <chrono>
 #include <thread>
-#include <QVector>
-#include <QMetaObject>
+#include <cmath>
+#include <cstring>
 
 #include "Bluetooth.h"
 #include "GlobalMedia.h"
 #include "../Helper.h"
 // #include "../Logger.h"
+#include "../Error.h"
 #include "../Assert.h"
-#include "../Application.h"
-#include "../Gui/MainWindow.h"
 
 using namespace Core;
 using namespace std::chrono_literals;
 
 namespace Core::AirPods {
+
+StateFields DiffState(const std::optional<State> &oldState, const State &newState)
+{
+    if (!oldState.has_value()) {
+        return StateField::All;
+    }
+
+    const auto &oldPods = oldState->pods, &newPods = newState.pods;
+    const auto &oldCase = oldState->caseBox, &newCase = newState.caseBox;
+
+    StateFields result = StateField::None;
+
+    const auto check = [&](bool changed, StateFields field) {
+        if (changed) {
+            result |= field;
+        }
+    };
+
+    check(oldPods.left.battery != newPods.left.battery, StateField::LeftBattery);
+    check(oldPods.left.isCharging != newPods.left.isCharging, StateField::LeftCharging);
+    check(oldPods.left.isInEar != newPods.left.isInEar, StateField::LeftInEar);
+    check(oldPods.right.battery != newPods.right.battery, StateField::RightBattery);
+    check(oldPods.right.isCharging != newPods.right.isCharging, StateField::RightCharging);
+    check(oldPods.right.isInEar != newPods.right.isInEar, StateField::RightInEar);
+    check(oldCase.battery != newCase.battery, StateField::CaseBattery);
+    check(oldCase.isCharging != newCase.isCharging, StateField::CaseCharging);
+    check(
+        oldCase.isLidOpened != newCase.isLidOpened ||
+            oldCase.isBothPodsInCase != newCase.isBothPodsInCase,
+        StateField::Lid);
+    check(oldState->model != newState.model, StateField::Model);
+
+    return result;
+}
+
 namespace Details {
 
 //
 // Advertisement
 //
 
-bool Advertisement::IsDesiredAdv(const Bluetooth::AdvertisementWatcher::ReceivedData &data)
+bool Advertisement::IsDesiredMfrData(uint16_t companyId, std::span<const uint8_t> data)
+{
+    return companyId == AppleCP::VendorId && AppleCP::Find<AppleCP::AirPods>(data).has_value();
+}
+
+auto Advertisement::Decode(const Bluetooth::AdvertisementWatcher::ReceivedData &data)
+    -> std::optional<Advertisement>
+{
+    return Decode(data, Clock::now());
+}
+
+auto Advertisement::Decode(
+    const Bluetooth::AdvertisementWatcher::ReceivedData &data, Timestamp timestamp)
+    -> std::optional<Advertisement>
 {
     auto iter = data.manufacturerDataMap.find(AppleCP::VendorId);
     if (iter == data.manufacturerDataMap.end()) {
-        return false;
+        return std::nullopt;
     }
 
-    const auto &manufacturerData = (*iter).second;
-    if (!AppleCP::AirPods::IsValid(manufacturerData)) {
-        return false;
+    auto protocol = AppleCP::Find<AppleCP::AirPods>((*iter).second);
+    if (!protocol.has_value()) {
+        return std::nullopt;
     }
 
-    return true;
+    return Advertisement{data, **protocol, timestamp};
 }
 
-Advertisement::Advertisement(const Bluetooth::AdvertisementWatcher::ReceivedData &data)
+Advertisement::Advertisement(
+    const Bluetooth::AdvertisementWatcher::ReceivedData &data, const AppleCP::AirPods &protocol,
+    Timestamp timestamp)
+    : _protocol{protocol}, _rssi{data.rssi}, _address{data.address}, _timestamp{timestamp}
 {
-    APD_ASSERT(IsDesiredAdv(data));
-    _data = data;
+}
 
-    auto protocol = AppleCP::As<AppleCP::AirPods>(GetMfrData());
-    APD_ASSERT(protocol.has_value());
-    _protocol = std::move(protocol.value());
+int16_t Advertisement::GetRssi() const
+{
+    return _rssi;
+}
+
+auto Advertisement::GetTimestamp() const -> Timestamp
+{
+    return _timestamp;
+}
+
+auto Advertisement::GetAddress() const -> AddressType
+{
+    return _address;
+}
+
+Side Advertisement::GetSide() const
+{
+    return _protocol.GetBroadcastedSide();
+}
 
-    // Store state
+uint64_t Advertisement::GetFingerprint() const
+{
+    // FNV-1a
     //
+    constexpr uint64_t kOffsetBasis = 0xCBF29CE484222325, kPrime = 0x100000001B3;
+
+    uint64_t result = kOffsetBasis;
+    const auto mix = [&](const void *data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            result ^= static_cast<const uint8_t *>(data)[i];
+            result *= kPrime;
+        }
+    };
+
+    mix(&_address, sizeof(_address));
+    mix(&_protocol, sizeof(_protocol));
+
+    return result != 0 ? result : 1;
+}
+
+std::vector<uint8_t> Advertisement::GetDesensitizedData() const
+{
+    auto desensitizedData = _protocol.Desensitize();
+
+    std::vector<uint8_t> result(sizeof(desensitizedData), 0);
+    std::memcpy(result.data(), &desensitizedData, sizeof(desensitizedData));
+    return result;
+}
 
-    _state.model = _protocol.GetModel();
-    _state.side = _protocol.GetBroadcastedSide();
+auto Advertisement::GetAdvState() const -> AdvState
+{
+    AdvState state;
+
+    state.model = _protocol.GetModel();
+    state.side = _protocol.GetBroadcastedSide();
 
-    _state.pods.left.battery = _protocol.GetLeftBattery();
-    _state.pods.left.isCharging = _protocol.IsLeftCharging();
-    _state.pods.left.isInEar = _protocol.IsLeftInEar();
+    state.pods.left.battery = _protocol.GetLeftBattery();
+    state.pods.left.isCharging = _protocol.IsLeftCharging();
+    state.pods.left.isInEar = _protocol.IsLeftInEar();
 
-    _state.pods.right.battery = _protocol.GetRightBattery();
-    _state.pods.right.isCharging = _protocol.IsRightCharging();
-    _state.pods.right.isInEar = _protocol.IsRightInEar();
+    state.pods.right.battery = _protocol.GetRightBattery();
+    state.pods.right.isCharging = _protocol.IsRightCharging();
+    state.pods.right.isInEar = _protocol.IsRightInEar();
 
-    _state.caseBox.battery = _protocol.GetCaseBattery();
-    _state.caseBox.isCharging = _protocol.IsCaseCharging();
+    state.caseBox.battery = _protocol.GetCaseBattery();
+    state.caseBox.isCharging = _protocol.IsCaseCharging();
 
-    _state.caseBox.isBothPodsInCase = _protocol.IsBothPodsInCase();
-    _state.caseBox.isLidOpened = _protocol.IsLidOpened();
+    state.caseBox.isBothPodsInCase = _protocol.IsBothPodsInCase();
+    state.caseBox.isLidOpened = _protocol.IsLidOpened();
 
-    if (_state.pods.left.battery.Available()) {
-        _state.pods.left.battery = _state.pods.left.battery.Value() * 10;
+    if (state.pods.left.battery.Available()) {
+        state.pods.left.battery = state.pods.left.battery.Value() * 10;
     }
-    if (_state.pods.right.battery.Available()) {
-        _state.pods.right.battery = _state.pods.right.battery.Value() * 10;
+    if (state.pods.right.battery.Available()) {
+        state.pods.right.battery = state.pods.right.battery.Value() * 10;
     }
-    if (_state.caseBox.battery.Available()) {
-        _state.caseBox.battery = _state.caseBox.battery.Value() * 10;
+    if (state.caseBox.battery.Available()) {
+        state.caseBox.battery = state.caseBox.battery.Value() * 10;
     }
+
+    return state;
 }
 
-int16_t Advertisement::GetRssi() const
+//
+// DeviceTracker
+//
+
+namespace {
+constexpr uint32_t kTrackMinHits = 3;
+constexpr float kTrackSwitchHysteresis = 0.15f; // 6 dBm
+constexpr auto kTrackStaleTimeout = 1s;
+constexpr auto kTrackRecentTimeout = 1s;
+} // namespace
+
+// Exponential moving average, O(1) state per track
+//
+float DeviceTracker::SmoothRssi(float smoothed, int16_t rssi)
 {
-    return _data.rssi;
+    return smoothed + kRssiSmoothing * (static_cast<float>(rssi) - smoothed);
 }
 
-const auto &Advertisement::GetTimestamp() const
+bool DeviceTracker::IsRssiInRange(float smoothed, int16_t rssiMin, bool wasInRange)
 {
-    return _data.timestamp;
+    return smoothed >= static_cast<float>(rssiMin) - (wasInRange ? kRssiHysteresis : 0.f);
 }
 
-auto Advertisement::GetAddress() const -> AddressType
+bool DeviceTracker::Feed(const Advertisement &adv)
 {
-    return _data.address;
+    const auto advState = adv.GetAdvState();
+
+    auto &track = Lookup(adv.GetAddress());
+    const size_t index = &track - _tracks.data();
+
+    AssignState(track, advState);
+    track.rssi =
+        track.hits == 0 ? static_cast<float>(adv.GetRssi()) : SmoothRssi(track.rssi, adv.GetRssi());
+    track.inRange = IsRssiInRange(track.rssi, _rssiMin, track.inRange);
+    track.lastSeen = adv.GetTimestamp();
+    track.hits += 1;
+
+    if (track.excluded) {
+        return false;
+    }
+
+    if (!track.inRange) {
+        // LOG(Warn, "DeviceTracker: RSSI is out of range. smoothed: '{}' min: '{}'", track.rssi,
+        //     _rssiMin);
+        return false;
+    }
+
+    return TryLock(index);
 }
 
-std::vector<uint8_t> Advertisement::GetDesensitizedData() const
+void DeviceTracker::RefreshLocked(Side side, float smoothedRssi, Advertisement::Timestamp timestamp)
 {
-    auto desensitizedData = _protocol.Desensitize();
+    const auto &locked = side == Side::Left ? _locked.left : _locked.right;
+    if (!locked.has_value()) {
+        return;
+    }
 
-    std::vector<uint8_t> result(sizeof(desensitizedData), 0);
-    std::memcpy(result.data(), &desensitizedData, sizeof(desensitizedData));
+    auto &track = _tracks[locked.value()];
+    if (timestamp > track.lastSeen) {
+        track.rssi = smoothedRssi;
+        track.lastSeen = timestamp;
+    }
+}
+
+std::optional<float> DeviceTracker::GetLockedRssi(Side side) const
+{
+    const auto &locked = side == Side::Left ? _locked.left : _locked.right;
+    if (!locked.has_value()) {
+        return std::nullopt;
+    }
+    return _tracks[locked.value()].rssi;
+}
+
+bool DeviceTracker::IsLocked(Advertisement::AddressType address) const
+{
+    const auto index = Find(address);
+    return index.has_value() && (_locked.left == index || _locked.right == index);
+}
+
+bool DeviceTracker::IsLocked(Side side) const
+{
+    return (side == Side::Left ? _locked.left : _locked.right).has_value();
+}
+
+std::optional<float> DeviceTracker::GetLockedDistance(const Advertisement &adv) const
+{
+    Track track;
+    AssignState(track, adv.GetAdvState());
+
+    std::optional<float> result;
+    for (const auto &locked : {_locked.left, _locked.right}) {
+        if (!locked.has_value() || Continuity(track, _tracks[locked.value()]) == 0.f) {
+            continue;
+        }
+        const auto distance = std::abs(_tracks[locked.value()].rssi - adv.GetRssi());
+        if (!result.has_value() || distance < result.value()) {
+            result = distance;
+        }
+    }
     return result;
 }
 
-auto Advertisement::GetAdvState() const -> const AdvState &
+void DeviceTracker::Exclude(Advertisement::AddressType address)
+{
+    auto &track = Lookup(address);
+    const size_t index = &track - _tracks.data();
+
+    track.excluded = true;
+    if (_locked.left == index) {
+        _locked.left.reset();
+    }
+    if (_locked.right == index) {
+        _locked.right.reset();
+    }
+}
+
+void DeviceTracker::Reset()
+{
+    _tracks.fill(Track{});
+    _locked.left.reset();
+    _locked.right.reset();
+}
+
+void DeviceTracker::OnRssiMinChanged(int16_t rssiMin)
+{
+    _rssiMin = rssiMin;
+}
+
+namespace {
+// Fibonacci hashing, the addresses are random anyway
+//
+size_t TrackHome(Advertisement::AddressType address, size_t mask)
+{
+    return static_cast<size_t>((address * 0x9E3779B97F4A7C15) >> 32) & mask;
+}
+} // namespace
+
+auto DeviceTracker::Lookup(Advertisement::AddressType address) -> Track &
+{
+    constexpr size_t kMask = kCapacity - 1;
+
+    const size_t home = TrackHome(address, kMask);
+
+    for (size_t i = 0; i < kCapacity; ++i) {
+        auto &track = _tracks[(home + i) & kMask];
+        if (track.address == address) {
+            return track;
+        }
+        if (track.address == 0) {
+            track.address = address;
+            return track;
+        }
+    }
+
+    // The table is full, replace the least recently seen track that isn't locked. Slots are never
+    // emptied once used, so the probe sequences of other tracks are not broken.
+    //
+    Track *oldest = nullptr;
+    for (size_t i = 0; i < kCapacity; ++i) {
+        if (_locked.left == i || _locked.right == i) {
+            continue;
+        }
+        if (oldest == nullptr || _tracks[i].lastSeen < oldest->lastSeen) {
+            oldest = &_tracks[i];
+        }
+    }
+    APD_ASSERT(oldest != nullptr);
+
+    *oldest = Track{};
+    oldest->address = address;
+    return *oldest;
+}
+
+std::optional<size_t> DeviceTracker::Find(Advertisement::AddressType address) const
+{
+    constexpr size_t kMask = kCapacity - 1;
+
+    const size_t home = TrackHome(address, kMask);
+
+    for (size_t i = 0; i < kCapacity; ++i) {
+        const size_t index = (home + i) & kMask;
+        if (_tracks[index].address == address) {
+            return index;
+        }
+        if (_tracks[index].address == 0) {
+            break;
+        }
+    }
+    return std::nullopt;
+}
+
+bool DeviceTracker::TryLock(size_t index)
+{
+    const auto &track = _tracks[index];
+
+    auto &locked = track.side == Side::Left ? _locked.left : _locked.right;
+    auto &anotherLocked = track.side == Side::Left ? _locked.right : _locked.left;
+
+    if (locked == index) {
+        return true;
+    }
+
+    if (track.hits < kTrackMinHits) {
+        return false;
+    }
+
+    const Track *anotherLockedTrack =
+        anotherLocked.has_value() ? &_tracks[anotherLocked.value()] : nullptr;
+
+    // Both pods broadcast the batteries of both pods, so they must be continuous with each other
+    //
+    const bool isContinuous =
+        anotherLockedTrack == nullptr || Continuity(track, *anotherLockedTrack) > 0.f;
+
+    // Nothing locked yet, wait until the closest one of the candidates shows up
+    //
+    if (!locked.has_value()) {
+        if (!isContinuous || !IsBestCandidate(index, anotherLockedTrack)) {
+            return false;
+        }
+        locked = index;
+        return true;
+    }
+
+    const auto &lockedTrack = _tracks[locked.value()];
+
+    // The address of our device is rotated
+    //
+    const bool isLockedStale = track.lastSeen - lockedTrack.lastSeen > kTrackStaleTimeout;
+    if (isLockedStale && isContinuous && Continuity(track, lockedTrack) > 0.f &&
+        IsBestCandidate(index, anotherLockedTrack))
+    {
+        // LOG(Info, "DeviceTracker: Lock is moved to a rotated address.");
+        locked = index;
+        return true;
+    }
+
+    // It's clearly closer than the locked one
+    //
+    if (Proximity(track.rssi) > Proximity(lockedTrack.rssi) + kTrackSwitchHysteresis) {
+        // LOG(Info, "DeviceTracker: Lock is moved to a closer track. RSSI: '{}' -> '{}'",
+        //     lockedTrack.rssi, track.rssi);
+        locked = index;
+
+        // The other pod we locked belongs to the previous device then, let it be locked again
+        //
+        if (!isContinuous) {
+            anotherLocked.reset();
+        }
+        return true;
+    }
+
+    return false;
+}
+
+// Whether the track is the closest one of the recently seen candidates on its side
+//
+bool DeviceTracker::IsBestCandidate(size_t index, const Track *anotherLocked) const
+{
+    const auto &track = _tracks[index];
+
+    for (size_t i = 0; i < kCapacity; ++i) {
+        const auto &other = _tracks[i];
+        if (i == index || other.address == 0 || other.side != track.side || !other.inRange ||
+            other.excluded || other.hits < kTrackMinHits ||
+            track.lastSeen - other.lastSeen > kTrackRecentTimeout)
+        {
+            continue;
+        }
+        if (anotherLocked != nullptr && Continuity(other, *anotherLocked) == 0.f) {
+            continue;
+        }
+        if (other.rssi > track.rssi) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void DeviceTracker::AssignState(Track &track, const Advertisement::AdvState &advState)
 {
-    return _state;
+    track.side = advState.side;
+    track.model = advState.model;
+    track.left = advState.pods.left.battery;
+    track.right = advState.pods.right.battery;
+    track.caseBox = advState.caseBox.battery;
 }
 
-const std::vector<uint8_t> &Advertisement::GetMfrData() const
+// 1 if they look identical, 0 if they can't be the same device
+//
+float DeviceTracker::Continuity(const Track &lhs, const Track &rhs)
 {
-    auto iter = _data.manufacturerDataMap.find(AppleCP::VendorId);
-    APD_ASSERT(iter != _data.manufacturerDataMap.end());
+    if (lhs.model != Model::Unknown && rhs.model != Model::Unknown && lhs.model != rhs.model) {
+        return 0.f;
+    }
+
+    // The battery changes in steps of 10%, so the data of two packets in a short time can not
+    // differ by more than one step if they are from the same device
+    //
+    uint32_t maxSteps = 0;
+
+    const auto compare = [&](const Battery &lhsBattery, const Battery &rhsBattery) {
+        if (lhsBattery.Available() && rhsBattery.Available()) {
+            const uint32_t lhsValue = lhsBattery.Value(), rhsValue = rhsBattery.Value();
+            const auto diff = lhsValue > rhsValue ? lhsValue - rhsValue : rhsValue - lhsValue;
+            maxSteps = std::max(maxSteps, diff / 10);
+        }
+    };
+
+    compare(lhs.left, rhs.left);
+    compare(lhs.right, rhs.right);
+    compare(lhs.caseBox, rhs.caseBox);
 
-    return (*iter).second;
+    return maxSteps == 0 ? 1.f : maxSteps == 1 ? 0.5f : 0.f;
+}
+
+// Maps [-90, -50] dBm to [0, 1]
+//
+float DeviceTracker::Proximity(float rssi)
+{
+    return std::clamp((rssi + 90.f) / 40.f, 0.f, 1.f);
+}
+
+//
+// DrainEstimator
+//
+
+void DrainEstimator::Update(const Battery &battery, bool isCharging, Clock::time_point timestamp)
+{
+    if (!battery.Available()) {
+        *this = DrainEstimator{};
+        return;
+    }
+
+    const auto value = battery.Value();
+
+    if (!_value.has_value() || isCharging != _isCharging) {
+        *this = DrainEstimator{};
+        _value = value;
+        _isCharging = isCharging;
+        return;
+    }
+
+    if (value == _value.value()) {
+        return;
+    }
+
+    // The time of the first step seen is unknown, the battery may have been at the value for a
+    // while before, so a rate is measured from the second step on
+    //
+    const bool isExpectedDirection = isCharging ? value > _value.value() : value < _value.value();
+    if (isExpectedDirection && _steppedAt.has_value() && timestamp > _steppedAt.value()) {
+        const auto seconds = std::chrono::duration<float>{timestamp - _steppedAt.value()}.count();
+        const auto rate =
+            (static_cast<float>(value) - static_cast<float>(_value.value())) / seconds;
+
+        _rate = _rate.has_value() ? kRateSmoothing * rate + (1.f - kRateSmoothing) * _rate.value()
+                                  : rate;
+    }
+
+    _value = value;
+    _steppedAt = isExpectedDirection ? std::optional{timestamp} : std::nullopt;
+}
+
+std::optional<std::chrono::seconds> DrainEstimator::GetTimeToEmpty() const
+{
+    if (_isCharging || !_value.has_value() || !_rate.has_value() || _rate.value() >= 0.f) {
+        return std::nullopt;
+    }
+    const auto remaining = static_cast<float>(_value.value());
+    return std::chrono::seconds{static_cast<int64_t>(remaining / -_rate.value())};
+}
+
+std::optional<std::chrono::seconds> DrainEstimator::GetTimeToFull() const
+{
+    if (!_isCharging || !_value.has_value() || !_rate.has_value() || _rate.value() <= 0.f) {
+        return std::nullopt;
+    }
+    const auto remaining = static_cast<float>(100 - std::min(_value.value(), 100u));
+    return std::chrono::seconds{static_cast<int64_t>(remaining / _rate.value())};
 }
 
 //
@@ -157,12 +599,62 @@ StateManager::StateManager()
 }
 
 std::optional<State> StateManager::GetCurrentState() const
+{
+    return GetSnapshot()->state;
+}
+
+auto StateManager::GetSnapshot() const -> std::shared_ptr<const Snapshot>
+{
+    return _snapshot.load();
+}
+
+void StateManager::PublishState(const State &state)
 {
     std::lock_guard<std::mutex> lock{_mutex};
-    return _cachedState;
+
+    if (_cachedState.has_value()) {
+        PublishSnapshot(state);
+    }
 }
 
-auto StateManager::OnAdvReceived(Advertisement adv) -> std::optional<UpdateEvent>
+bool StateManager::OnRepeatedAdvReceived(const Advertisement &adv)
+{
+    const auto side = adv.GetSide();
+    if (side != Side::Left && side != Side::Right) {
+        return false;
+    }
+
+    const auto fingerprint = adv.GetFingerprint();
+    const auto rssi = adv.GetRssi();
+
+    if (side == Side::Left) {
+        const auto smoothedRssi = DeviceTracker::SmoothRssi(_lastRssi.left, rssi);
+        if (_lastFingerprint.left != fingerprint ||
+            !DeviceTracker::IsRssiInRange(smoothedRssi, _rssiMin, true))
+        {
+            return false;
+        }
+        _lastRssi.left = smoothedRssi;
+        _lastSeen.left = adv.GetTimestamp();
+        _stateResetTimer.left.Reset();
+    }
+    else {
+        const auto smoothedRssi = DeviceTracker::SmoothRssi(_lastRssi.right, rssi);
+        if (_lastFingerprint.right != fingerprint ||
+            !DeviceTracker::IsRssiInRange(smoothedRssi, _rssiMin, true))
+        {
+            return false;
+        }
+        _lastRssi.right = smoothedRssi;
+        _lastSeen.right = adv.GetTimestamp();
+        _stateResetTimer.right.Reset();
+    }
+
+    _lostTimer.Reset();
+    return true;
+}
+
+auto StateManager::OnAdvReceived(const Advertisement &adv) -> std::optional<UpdateEvent>
 {
     std::lock_guard<std::mutex> lock{_mutex};
 
@@ -171,7 +663,12 @@ auto StateManager::OnAdvReceived(Advertisement adv) -> std::optional<UpdateEvent
         return std::nullopt;
     }
 
-    UpdateAdv(std::move(adv));
+    UpdateAdv(adv);
+
+    if (_batching) {
+        _batchPending = true;
+        return std::nullopt;
+    }
     return UpdateState();
 }
 
@@ -183,118 +680,109 @@ void StateManager::Disconnect()
     ResetAll();
 }
 
-void StateManager::OnRssiMinChanged(int16_t rssiMin)
+bool StateManager::IsLockedAddress(Advertisement::AddressType address) const
 {
     std::lock_guard<std::mutex> lock{_mutex};
-    _rssiMin = rssiMin;
+    return _tracker.IsLocked(address);
 }
 
-bool StateManager::IsPossibleDesiredAdv(const Advertisement &adv) const
+bool StateManager::IsLockedSide(Side side) const
 {
-    const auto advRssi = adv.GetRssi();
-    if (advRssi < _rssiMin) {
-        // LOG(Warn,
-        //     "IsPossibleDesiredAdv returns false. Reason: RSSI is less than the limit. "
-        //     "curr: '{}' min: '{}'",
-        //     advRssi, _rssiMin);
-        return false;
-    }
+    std::lock_guard<std::mutex> lock{_mutex};
+    return _tracker.IsLocked(side);
+}
 
-    const auto &advState = adv.GetAdvState();
+std::optional<float> StateManager::GetLockedDistance(const Advertisement &adv) const
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    return _tracker.GetLockedDistance(adv);
+}
 
-    auto &lastAdv = advState.side == Side::Left ? _adv.left : _adv.right;
-    auto &lastAnotherAdv = advState.side == Side::Left ? _adv.right : _adv.left;
+void StateManager::ExcludeAddress(Advertisement::AddressType address)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    _tracker.Exclude(address);
 
-    // If the Random Non-resolvable Address of our devices is changed
-    // or the packet is sent from another device that it isn't ours
+    // Stop the fast path from accepting its repeats
     //
-    if (lastAdv.has_value() && lastAdv->first.GetAddress() != adv.GetAddress()) {
-        const auto &lastAdvState = lastAdv->first.GetAdvState();
-
-        if (advState.model != lastAdvState.model) {
-            // LOG(Warn, "IsPossibleDesiredAdv returns false. Reason: model new='{}' old='{}'",
-            //     Helper::ToString(advState.model), Helper::ToString(lastAdvState.model));
-            return false;
-        }
-
-        Battery::ValueType leftBatteryDiff = 0, rightBatteryDiff = 0, caseBatteryDiff = 0;
+    if (_adv.left.has_value() && _adv.left->GetAddress() == address) {
+        _lastFingerprint.left = 0;
+    }
+    if (_adv.right.has_value() && _adv.right->GetAddress() == address) {
+        _lastFingerprint.right = 0;
+    }
+}
 
-        using SignedBatteryValueT = std::make_signed_t<Battery::ValueType>;
+void StateManager::SetBatching(bool enable)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    _batching = enable;
+}
 
-        if (advState.pods.left.battery.Available() && lastAdvState.pods.left.battery.Available()) {
-            leftBatteryDiff = std::abs(
-                static_cast<SignedBatteryValueT>(advState.pods.left.battery.Value()) -
-                static_cast<SignedBatteryValueT>(lastAdvState.pods.left.battery.Value()));
-        }
-        if (advState.pods.right.battery.Available() && lastAdvState.pods.right.battery.Available())
-        {
-            rightBatteryDiff = std::abs(
-                static_cast<SignedBatteryValueT>(advState.pods.right.battery.Value()) -
-                static_cast<SignedBatteryValueT>(lastAdvState.pods.right.battery.Value()));
-        }
-        if (advState.caseBox.battery.Available() && lastAdvState.caseBox.battery.Available()) {
-            caseBatteryDiff = std::abs(
-                static_cast<SignedBatteryValueT>(advState.caseBox.battery.Value()) -
-                static_cast<SignedBatteryValueT>(lastAdvState.caseBox.battery.Value()));
-        }
+auto StateManager::Flush() -> std::optional<UpdateEvent>
+{
+    std::lock_guard<std::mutex> lock{_mutex};
 
-        // The battery changes in steps of 1, so the data of two packets in a short time
-        // can not exceed 1, otherwise it is not our device
-        //
-        if (leftBatteryDiff > 1 || rightBatteryDiff > 1 || caseBatteryDiff > 1) {
-            // LOG(Warn,
-            //     "IsPossibleDesiredAdv returns false. Reason: BatteryDiff l='{}' r='{}' c='{}'",
-            //     leftBatteryDiff, rightBatteryDiff, caseBatteryDiff);
-            return false;
-        }
+    if (!_batchPending) {
+        return std::nullopt;
+    }
+    _batchPending = false;
+    return UpdateState();
+}
 
-        int16_t rssiDiff = std::abs(advRssi - lastAdv->first.GetRssi());
-        if (rssiDiff > 50) {
-            // LOG(Warn, "IsPossibleDesiredAdv returns false. Reason: Current side rssiDiff '{}'",
-            //     rssiDiff);
-            return false;
-        }
+void StateManager::OnRssiMinChanged(int16_t rssiMin)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    _rssiMin = rssiMin;
+    _tracker.OnRssiMinChanged(rssiMin);
+}
 
-        // LOG(Warn, "Address changed, but it might still be the same device.");
+bool StateManager::IsPossibleDesiredAdv(const Advertisement &adv)
+{
+    // Repeats are handled by `OnRepeatedAdvReceived` without the lock, catch up with them
+    //
+    if (_adv.left.has_value()) {
+        _tracker.RefreshLocked(Side::Left, _lastRssi.left, _lastSeen.left);
     }
-
-    if (lastAnotherAdv.has_value()) {
-        int16_t rssiDiff = std::abs(advRssi - lastAnotherAdv->first.GetRssi());
-        if (rssiDiff > 50) {
-            // LOG(Warn, "IsPossibleDesiredAdv returns false. Reason: Another side rssiDiff '{}'",
-            //     rssiDiff);
-            return false;
-        }
+    if (_adv.right.has_value()) {
+        _tracker.RefreshLocked(Side::Right, _lastRssi.right, _lastSeen.right);
     }
 
-    return true;
+    return _tracker.Feed(adv);
 }
 
-void StateManager::UpdateAdv(Advertisement adv)
+void StateManager::UpdateAdv(const Advertisement &adv)
 {
     _lostTimer.Reset();
 
-    const auto &advState = adv.GetAdvState();
+    const auto side = adv.GetSide();
 
-    if (advState.side == Side::Left) {
+    if (side == Side::Left) {
         _stateResetTimer.left.Reset();
-        _adv.left = std::make_pair(std::move(adv), Clock::now());
+        _adv.left = adv;
+        _lastRssi.left = _tracker.GetLockedRssi(Side::Left).value_or(adv.GetRssi());
+        _lastSeen.left = adv.GetTimestamp();
+        _lastFingerprint.left = adv.GetFingerprint();
     }
-    else if (advState.side == Side::Right) {
+    else if (side == Side::Right) {
         _stateResetTimer.right.Reset();
-        _adv.right = std::make_pair(std::move(adv), Clock::now());
+        _adv.right = adv;
+        _lastRssi.right = _tracker.GetLockedRssi(Side::Right).value_or(adv.GetRssi());
+        _lastSeen.right = adv.GetTimestamp();
+        _lastFingerprint.right = adv.GetFingerprint();
     }
 }
 
 auto StateManager::UpdateState() -> std::optional<UpdateEvent>
 {
-    Helper::Sides<std::pair<Advertisement::AdvState, Timestamp>> cachedAdvState;
+    Helper::Sides<std::pair<Advertisement::AdvState, Advertisement::Timestamp>> cachedAdvState;
 
     if (_adv.left.has_value()) {
-        cachedAdvState.left = std::make_pair(_adv.left->first.GetAdvState(), _adv.left->second);
+        cachedAdvState.left = std::make_pair(_adv.left->GetAdvState(), _adv.left->GetTimestamp());
     }
     if (_adv.right.has_value()) {
-        cachedAdvState.right = std::make_pair(_adv.right->first.GetAdvState(), _adv.right->second);
+        cachedAdvState.right =
+            std::make_pair(_adv.right->GetAdvState(), _adv.right->GetTimestamp());
     }
 
     State newState;
@@ -326,21 +814,37 @@ auto StateManager::UpdateState() -> std::optional<UpdateEvent>
         return std::nullopt;
     }
 
+    const auto changedFields = DiffState(_cachedState, newState);
+
     auto oldState = std::move(_cachedState);
     _cachedState = std::move(newState);
 
-    return UpdateEvent{.oldState = std::move(oldState), .newState = _cachedState.value()};
+    return UpdateEvent{
+        .oldState = std::move(oldState),
+        .newState = _cachedState.value(),
+        .changedFields = changedFields};
 }
 
 void StateManager::ResetAll()
 {
+    _adv.left.reset();
+    _adv.right.reset();
+    _lastFingerprint.left = 0;
+    _lastFingerprint.right = 0;
+    _batchPending = false;
+    _tracker.Reset();
+
     if (_cachedState.has_value()) {
-        ApdApp->GetMainWindow()->DisconnectSafely();
+        _cachedState.reset();
+        PublishSnapshot(std::nullopt);
+        _cbLost.Invoke();
     }
+}
 
-    _adv.left.reset();
-    _adv.right.reset();
-    _cachedState.reset();
+void StateManager::PublishSnapshot(std::optional<State> state)
+{
+    _snapshot = std::make_shared<const Snapshot>(
+        Snapshot{.version = _snapshot.load()->version + 1, .state = std::move(state)});
 }
 
 void StateManager::DoLost()
@@ -357,6 +861,7 @@ void StateManager::DoStateReset(Side side)
     if (adv.has_value()) {
         // LOG(Info, "StateManager: DoStateReset called. Side: {}", Helper::ToString(side));
         adv.reset();
+        (side == Side::Left ? _lastFingerprint.left : _lastFingerprint.right) = 0;
     }
 }
 } // namespace Details
@@ -365,10 +870,22 @@ void StateManager::DoStateReset(Side side)
 // Manager
 //
 
+namespace {
+constexpr size_t kMaxRoutes = 64;
+} // namespace
+
+Manager::BoundDevice::BoundDevice(DeviceKey key, Bluetooth::Device device)
+    : key{key}, device{std::move(device)}
+{
+}
+
 Manager::Manager()
 {
+    _adWatcher.SetFilter(&Details::Advertisement::IsDesiredMfrData);
+
+    // Locks by itself, so repeated advertisements don't contend for the lock
+    //
     _adWatcher.CbReceived() += [this](auto &&...args) {
-        std::lock_guard<std::mutex> lock{_mutex};
         OnAdvertisementReceived(std::forward<decltype(args)>(args)...);
     };
 
@@ -378,6 +895,27 @@ Manager::Manager()
     };
 }
 
+auto Manager::GetSnapshot(DeviceKey key) const
+    -> std::shared_ptr<const Details::StateManager::Snapshot>
+{
+    const auto devices = _devices.load();
+    for (const auto &device : *devices) {
+        if (device->key == key) {
+            return device->stateMgr.GetSnapshot();
+        }
+    }
+    return nullptr;
+}
+
+bool Manager::OpenBatteryHistory(const std::filesystem::path &path)
+{
+    if (!_batteryHistory.Open(path)) {
+        // LOG(Warn, "Open battery history failed. Path: '{}'", path.string());
+        return false;
+    }
+    return true;
+}
+
 void Manager::StartScanner()
 {
     if (!_adWatcher.Start()) {
@@ -401,7 +939,48 @@ void Manager::StopScanner()
 void Manager::OnRssiMinChanged(int16_t rssiMin)
 {
     std::lock_guard<std::mutex> lock{_mutex};
-    _stateMgr.OnRssiMinChanged(rssiMin);
+
+    _rssiMin = rssiMin;
+    const auto devices = _devices.load();
+    for (const auto &device : *devices) {
+        device->stateMgr.OnRssiMinChanged(rssiMin);
+    }
+}
+
+void Manager::OnStateBatchWindowChanged(std::chrono::milliseconds window)
+{
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+
+        _batching = window.count() > 0;
+        const auto devices = _devices.load();
+        for (const auto &device : *devices) {
+            device->stateMgr.SetBatching(_batching);
+        }
+    }
+
+    // The timer callback takes `_mutex`, so don't hold it while starting or stopping the timer
+    //
+    if (window.count() > 0) {
+        _batchTimer.Start(window, [this] { OnBatchWindowElapsed(); });
+    }
+    else {
+        _batchTimer.Stop();
+        OnBatchWindowElapsed(); // Apply the pending advertisements
+    }
+}
+
+void Manager::OnBatchWindowElapsed()
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+
+    const auto devices = _devices.load();
+    for (const auto &device : *devices) {
+        auto optUpdateEvent = device->stateMgr.Flush();
+        if (optUpdateEvent.has_value()) {
+            OnStateChanged(*device, std::move(optUpdateEvent.value()));
+        }
+    }
 }
 
 void Manager::OnAutomaticEarDetectionChanged(bool enable)
@@ -410,89 +989,179 @@ void Manager::OnAutomaticEarDetectionChanged(bool enable)
     _automaticEarDetection = enable;
 }
 
-void Manager::OnBoundDeviceAddressChanged(uint64_t address)
+void Manager::OnBoundDevicesChanged(const std::vector<uint64_t> &addresses)
 {
     std::unique_lock<std::mutex> lock{_mutex};
 
-    _boundDevice.reset();
-    _deviceConnected = false;
-    _stateMgr.Disconnect();
+    const auto oldDevices = _devices.load();
+    auto newDevices = std::make_shared<BoundDevices>();
+    BoundDevices addedDevices;
 
-    // Unbind device
-    //
-    if (address == 0) {
-        // LOG(Info, "Unbind device.");
-        return;
-    }
+    const auto findDevice = [](const BoundDevices &devices, DeviceKey key) {
+        return std::find_if(devices.begin(), devices.end(), [&](const auto &device) {
+            return device->key == key;
+        });
+    };
 
-    // Bind to a new device
-    //
-    // LOG(Info, "Bind a new device.");
+    for (const auto address : addresses) {
+        if (address == 0 || findDevice(*newDevices, address) != newDevices->end()) {
+            continue;
+        }
 
-    auto optDevice = Bluetooth::DeviceManager::FindDevice(address);
-    if (!optDevice.has_value()) {
-        // LOG(Error, "Find device by address failed.");
-        return;
-    }
+        if (newDevices->size() == kMaxBoundDevices) {
+            // LOG(Warn, "Too many devices to bind, the rest are ignored.");
+            break;
+        }
 
-    _boundDevice = std::move(optDevice);
+        // Keep the state of the devices that are still bound
+        //
+        if (auto iter = findDevice(*oldDevices, address); iter != oldDevices->end()) {
+            newDevices->push_back(*iter);
+            continue;
+        }
 
-    _deviceName = QString::fromStdString([&] {
-        auto name = _boundDevice->GetName();
-        // See https://github.com/SpriteOvO/AirPodsDesktop/issues/15
-        return name.find("Bluetooth") != std::string::npos ? std::string{} : name;
-    }());
+        // Bind to a new device
+        //
+        // LOG(Info, "Bind a new device.");
 
-    _boundDevice->CbConnectionStatusChanged() += [this](auto &&...args) {
-        std::lock_guard<std::mutex> lock{_mutex};
-        OnBoundDeviceConnectionStateChanged(std::forward<decltype(args)>(args)...);
-    };
+        auto optDevice = Bluetooth::DeviceManager::FindDevice(address);
+        if (!optDevice.has_value()) {
+            // LOG(Error, "Find device by address failed.");
+            continue;
+        }
+
+        auto device = std::make_shared<BoundDevice>(address, std::move(optDevice.value()));
+
+        device->model = AppleCP::AirPods::GetModel(device->device.GetProductId());
+        device->name = QString::fromStdString([&] {
+            auto name = device->device.GetName();
+            // See https://github.com/SpriteOvO/AirPodsDesktop/issues/15
+            return name.find("Bluetooth") != std::string::npos ? std::string{} : name;
+        }());
+
+        device->stateMgr.OnRssiMinChanged(_rssiMin);
+        device->stateMgr.SetBatching(_batching);
+        device->stateMgr.CbLost() += [this, key = device->key] { _cbDisconnected.Invoke(key); };
+
+        device->device.CbConnectionStatusChanged() +=
+            [this, weakDevice = std::weak_ptr{device}](Bluetooth::DeviceState state) {
+                std::lock_guard<std::mutex> lock{_mutex};
+                if (auto device = weakDevice.lock()) {
+                    OnBoundDeviceConnectionStateChanged(*device, state);
+                }
+            };
+
+        newDevices->push_back(device);
+        addedDevices.push_back(std::move(device));
+    }
 
-    OnBoundDeviceConnectionStateChanged(_boundDevice->GetConnectionState());
+    // Unbind the devices that are no longer in the list
+    //
+    for (const auto &device : *oldDevices) {
+        if (findDevice(*newDevices, device->key) == newDevices->end()) {
+            // LOG(Info, "Unbind device.");
+            device->connected = false;
+            device->stateMgr.Disconnect();
+        }
+    }
+
+    _routes.clear();
+    _devices = std::move(newDevices);
+
+    for (const auto &device : addedDevices) {
+        OnBoundDeviceConnectionStateChanged(*device, device->device.GetConnectionState());
+    }
 }
 
-void Manager::OnBoundDeviceConnectionStateChanged(Bluetooth::DeviceState state)
+void Manager::OnBoundDeviceConnectionStateChanged(BoundDevice &device, Bluetooth::DeviceState state)
 {
     bool newDeviceConnected = state == Bluetooth::DeviceState::Connected;
-    bool doDisconnect = _deviceConnected && !newDeviceConnected;
-    _deviceConnected = newDeviceConnected;
+    bool doDisconnect = device.connected && !newDeviceConnected;
+    device.connected = newDeviceConnected;
 
     if (doDisconnect) {
-        _stateMgr.Disconnect();
+        device.stateMgr.Disconnect();
     }
 
-    // LOG(Info, "The device we bound is updated. current: {}, new: {}", _deviceConnected,
+    // LOG(Info, "A device we bound is updated. current: {}, new: {}", device.connected,
     //     newDeviceConnected);
 }
 
-void Manager::OnStateChanged(Details::StateManager::UpdateEvent updateEvent)
+// Returns true if the advertisement is accepted by the device
+//
+bool Manager::OnDeviceAdvReceived(BoundDevice &device, const Details::Advertisement &adv)
+{
+    auto optUpdateEvent = device.stateMgr.OnAdvReceived(adv);
+    if (optUpdateEvent.has_value()) {
+        OnStateChanged(device, std::move(optUpdateEvent.value()));
+    }
+    return device.stateMgr.IsLockedAddress(adv.GetAddress());
+}
+
+void Manager::OnStateChanged(BoundDevice &device, Details::StateManager::UpdateEvent updateEvent)
 {
     const auto &oldState = updateEvent.oldState;
     auto &newState = updateEvent.newState;
+    const auto changedFields = updateEvent.changedFields;
 
-    newState.displayName =
-        _deviceName.isEmpty() ? Helper::ToString(newState.model) : _deviceName.remove(" - Find My");
-
-    ApdApp->GetMainWindow()->UpdateStateSafely(newState);
+    newState.displayName = device.name.isEmpty() ? Helper::ToString(newState.model)
+                                                 : QString{device.name}.remove(" - Find My");
 
-    // Lid opened
+    // Time remaining. The rates measured before the device was lost or disconnected are stale.
     //
-    bool newLidOpened = newState.caseBox.isLidOpened && newState.caseBox.isBothPodsInCase;
-    bool lidStateSwitched;
     if (!oldState.has_value()) {
-        lidStateSwitched = newLidOpened;
+        device.leftDrain = {};
+        device.rightDrain = {};
+        device.caseDrain = {};
     }
-    else {
-        bool oldLidOpened = oldState->caseBox.isLidOpened && oldState->caseBox.isBothPodsInCase;
-        lidStateSwitched = oldLidOpened != newLidOpened;
+
+    const auto now = Details::DrainEstimator::Clock::now();
+    const auto estimate = [&](Details::DrainEstimator &estimator, Details::BasicState &state,
+                              StateFields fields) {
+        if (changedFields & fields) {
+            estimator.Update(state.battery, state.isCharging, now);
+        }
+        state.timeToEmpty = estimator.GetTimeToEmpty();
+        state.timeToFull = estimator.GetTimeToFull();
+    };
+    estimate(
+        device.leftDrain, newState.pods.left, StateField::LeftBattery | StateField::LeftCharging);
+    estimate(
+        device.rightDrain, newState.pods.right,
+        StateField::RightBattery | StateField::RightCharging);
+    estimate(
+        device.caseDrain, newState.caseBox, StateField::CaseBattery | StateField::CaseCharging);
+
+    device.stateMgr.PublishState(newState);
+    _cbStateChanged.Invoke(device.key, newState, changedFields);
+
+    // Battery history
+    //
+    constexpr StateFields kHistoryFields = StateField::LeftBattery | StateField::LeftCharging |
+                                           StateField::RightBattery | StateField::RightCharging |
+                                           StateField::CaseBattery | StateField::CaseCharging;
+    if (changedFields & kHistoryFields) {
+        _batteryHistory.Append(BatteryHistory::Sample{
+            .time = BatteryHistory::Clock::now(),
+            .key = device.key,
+            .left = newState.pods.left.battery,
+            .right = newState.pods.right.battery,
+            .caseBox = newState.caseBox.battery,
+            .charging = static_cast<uint8_t>(
+                (newState.pods.left.isCharging ? BatteryHistory::Bit::Left : 0) |
+                (newState.pods.right.isCharging ? BatteryHistory::Bit::Right : 0) |
+                (newState.caseBox.isCharging ? BatteryHistory::Bit::Case : 0))});
     }
-    if (lidStateSwitched) {
-        OnLidOpened(newLidOpened);
+
+    // Lid opened
+    //
+    if (changedFields & StateField::Lid) {
+        OnLidStateChanged(device.key, oldState, newState);
     }
 
     // Both in ear
     //
-    if (oldState.has_value()) {
+    if (oldState.has_value() && changedFields & (StateField::LeftInEar | StateField::RightInEar)) {
         bool oldBothInEar = oldState->pods.left.isInEar && oldState->pods.right.isInEar;
         bool newBothInEar = newState.pods.left.isInEar && newState.pods.right.isInEar;
         if (oldBothInEar != newBothInEar) {
@@ -501,17 +1170,28 @@ void Manager::OnStateChanged(Details::StateManager::UpdateEvent updateEvent)
     }
 }
 
-void Manager::OnLidOpened(bool opened)
+void Manager::OnLidStateChanged(
+    DeviceKey key, const std::optional<State> &oldState, const State &newState)
 {
-    auto &mainWindow = ApdApp->GetMainWindow();
-    if (opened) {
-        mainWindow->ShowSafely();
+    bool newLidOpened = newState.caseBox.isLidOpened && newState.caseBox.isBothPodsInCase;
+    bool lidStateSwitched;
+    if (!oldState.has_value()) {
+        lidStateSwitched = newLidOpened;
     }
     else {
-        mainWindow->HideSafely();
+        bool oldLidOpened = oldState->caseBox.isLidOpened && oldState->caseBox.isBothPodsInCase;
+        lidStateSwitched = oldLidOpened != newLidOpened;
+    }
+    if (lidStateSwitched) {
+        OnLidOpened(key, newLidOpened);
     }
 }
 
+void Manager::OnLidOpened(DeviceKey key, bool opened)
+{
+    _cbLidOpened.Invoke(key, opened);
+}
+
 void Manager::OnBothInEar(bool isBothInEar)
 {
     if (!_automaticEarDetection) {
@@ -529,25 +1209,104 @@ void Manager::OnBothInEar(bool isBothInEar)
 
 bool Manager::OnAdvertisementReceived(const Bluetooth::AdvertisementWatcher::ReceivedData &data)
 {
-    if (!Details::Advertisement::IsDesiredAdv(data)) {
+    auto optAdv = Details::Advertisement::Decode(data);
+    if (!optAdv.has_value()) {
         return false;
     }
-
-    Details::Advertisement adv{data};
+    const auto &adv = optAdv.value();
 
     // LOG(Trace, "AirPods advertisement received. Data: {}, Address Hash: {}, RSSI: {}",
-        Helper::ToString(adv.GetDesensitizedData()), Helper::Hash(data.address), data.rssi);
+    //     Helper::ToString(adv.GetDesensitizedData()), Helper::Hash(data.address), data.rssi);
 
-    if (!_deviceConnected) {
-        // LOG(Info, "AirPods advertisement received, but device disconnected.");
-        return false;
+    // At most `kMaxBoundDevices` devices to check, and each check is a couple of atomic loads
+    //
+    auto devices = _devices.load();
+    for (const auto &device : *devices) {
+        if (device->connected && device->stateMgr.OnRepeatedAdvReceived(adv)) {
+            return true;
+        }
     }
 
-    auto optUpdateEvent = _stateMgr.OnAdvReceived(Details::Advertisement{data});
-    if (optUpdateEvent.has_value()) {
-        OnStateChanged(std::move(optUpdateEvent.value()));
+    std::lock_guard<std::mutex> lock{_mutex};
+
+    // Load again, it may have been changed before we acquired the lock
+    //
+    devices = _devices.load();
+
+    // Route to the device which accepted the address before
+    //
+    if (auto iter = _routes.find(adv.GetAddress()); iter != _routes.end()) {
+        auto &device = *devices->at(iter->second);
+        if (!device.connected) {
+            // LOG(Info, "AirPods advertisement received, but device disconnected.");
+            return false;
+        }
+        if (OnDeviceAdvReceived(device, adv)) {
+            return true;
+        }
+        _routes.erase(iter);
     }
-    return true;
+
+    // Offer it to the devices in the order they are bound, the first one that locks onto it
+    // claims the address. If it may be from a pair that is already tracked, e.g. its address is
+    // rotated and the new one is not locked yet, only the device tracking the closest such pair
+    // gets it, the others which locked their own pod of this side must not steal it.
+    //
+    const auto advState = adv.GetAdvState();
+
+    std::array<bool, kMaxBoundDevices> isCandidate{};
+    std::optional<size_t> owner;
+    float ownerDistance = 0.f;
+
+    for (size_t i = 0; i < devices->size(); ++i) {
+        const auto &device = *devices->at(i);
+        isCandidate[i] = device.connected &&
+                         (device.model == Model::Unknown || advState.model == Model::Unknown ||
+                          device.model == advState.model);
+        if (!isCandidate[i]) {
+            continue;
+        }
+        const auto distance = device.stateMgr.GetLockedDistance(adv);
+        if (distance.has_value() && (!owner.has_value() || distance.value() < ownerDistance)) {
+            owner = i;
+            ownerDistance = distance.value();
+        }
+    }
+
+    const auto claim = [&](size_t index) {
+        auto &device = *devices->at(index);
+        if (!OnDeviceAdvReceived(device, adv)) {
+            return false;
+        }
+
+        if (_routes.size() >= kMaxRoutes) {
+            _routes.clear();
+        }
+        _routes[adv.GetAddress()] = index;
+
+        for (const auto &another : *devices) {
+            if (another.get() != &device) {
+                another->stateMgr.ExcludeAddress(adv.GetAddress());
+            }
+        }
+        return true;
+    };
+
+    if (owner.has_value() && claim(owner.value())) {
+        return true;
+    }
+
+    for (size_t i = 0; i < devices->size(); ++i) {
+        if (!isCandidate[i] || owner == i ||
+            (owner.has_value() && devices->at(i)->stateMgr.IsLockedSide(advState.side)))
+        {
+            continue;
+        }
+        if (claim(i)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void Manager::OnAdvWatcherStateChanged(
@@ -555,12 +1314,12 @@ void Manager::OnAdvWatcherStateChanged(
 {
     switch (state) {
     case Core::Bluetooth::AdvertisementWatcher::State::Started:
-        ApdApp->GetMainWindow()->AvailableSafely();
+        _cbAvailabilityChanged.Invoke(true);
         // LOG(Info, "Bluetooth AdvWatcher started.");
         break;
 
     case Core::Bluetooth::AdvertisementWatcher::State::Stopped:
-        ApdApp->GetMainWindow()->UnavailableSafely();
+        _cbAvailabilityChanged.Invoke(false);
         // LOG(Warn, "Bluetooth AdvWatcher stopped. Error: '{}'.", optError.value_or("nullopt"));
         break;
 
@@ -18,10 +18,16 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <functional>
+#include <unordered_map>
 
 #include "Bluetooth.h"
 #include "AppleCP.h"
+#include "BatteryHistory.h"
 
 namespace Core::AirPods {
 
@@ -35,6 +41,9 @@ struct BasicState {
     Battery battery;
     bool isCharging{false};
 
+    // Estimated by `Manager` from the recent drain or charge rate, nullopt if unknown yet
+    std::optional<std::chrono::seconds> timeToEmpty, timeToFull;
+
     bool operator==(const BasicState &rhs) const = default;
 };
 } // namespace Details
@@ -67,106 +76,387 @@ struct State {
     bool operator==(const State &rhs) const = default;
 };
 
+// Bitmask of the fields that differ between two states
+//
+namespace StateField {
+enum : uint32_t {
+    None = 0,
+
+    LeftBattery = 1 << 0,
+    LeftCharging = 1 << 1,
+    LeftInEar = 1 << 2,
+    RightBattery = 1 << 3,
+    RightCharging = 1 << 4,
+    RightInEar = 1 << 5,
+    CaseBattery = 1 << 6,
+    CaseCharging = 1 << 7,
+    Lid = 1 << 8, // `isLidOpened` or `isBothPodsInCase`
+    Model = 1 << 9,
+
+    All = (1 << 10) - 1
+};
+} // namespace StateField
+
+using StateFields = uint32_t;
+
+StateFields DiffState(const std::optional<State> &oldState, const State &newState);
+
 //
 // Classes
 //
 
 namespace Details {
 
+// A compact, fixed-size record of an AirPods advertisement.
+//
+// Only the proximity pairing payload and the few fields we need from the received data are kept,
+// so it has no heap members and can be stored, copied and compared without allocating. The state
+// is decoded from the payload on demand.
+//
 class Advertisement
 {
 public:
     using AddressType = decltype(Bluetooth::AdvertisementWatcher::ReceivedData::address);
+    using Clock = std::chrono::steady_clock;
+    using Timestamp = Clock::time_point;
 
     struct AdvState : AirPods::State {
         Side side;
     };
 
-    static bool IsDesiredAdv(const Bluetooth::AdvertisementWatcher::ReceivedData &data);
+    // Cheap check on the raw manufacturer data, used to drop other advertisements before they
+    // are copied out of the Bluetooth stack.
+    //
+    static bool IsDesiredMfrData(uint16_t companyId, std::span<const uint8_t> data);
 
-    Advertisement(const Bluetooth::AdvertisementWatcher::ReceivedData &data);
+    // Validates and decodes the received data in a single pass. Returns `std::nullopt` if it
+    // isn't an advertisement broadcast from AirPods. The timestamp can be given for replays.
+    //
+    static std::optional<Advertisement>
+    Decode(const Bluetooth::AdvertisementWatcher::ReceivedData &data);
+    static std::optional<Advertisement>
+    Decode(const Bluetooth::AdvertisementWatcher::ReceivedData &data, Timestamp timestamp);
 
     int16_t GetRssi() const;
-    const auto &GetTimestamp() const;
+    Timestamp GetTimestamp() const;
     AddressType GetAddress() const;
+    Side GetSide() const;
+    // Identifies the address and the payload bytes, never 0
+    uint64_t GetFingerprint() const;
     std::vector<uint8_t> GetDesensitizedData() const;
-    const AdvState &GetAdvState() const;
+    AdvState GetAdvState() const;
 
 private:
-    Bluetooth::AdvertisementWatcher::ReceivedData _data;
     AppleCP::AirPods _protocol;
-    AdvState _state;
+    int16_t _rssi;
+    AddressType _address;
+    Timestamp _timestamp; // Monotonic, taken when the advertisement is decoded
 
-    const std::vector<uint8_t> &GetMfrData() const;
+    Advertisement(
+        const Bluetooth::AdvertisementWatcher::ReceivedData &data,
+        const AppleCP::AirPods &protocol, Timestamp timestamp);
 };
+static_assert(std::is_trivially_copyable_v<Advertisement>);
+static_assert(sizeof(Advertisement) <= 64);
 
 // AirPods use Random Non-resolvable device addresses for privacy reasons. This means we
-// can't "Remember" the user's AirPods by any device property. Here we track our desired
-// devices in some non-elegant ways, but obviously it is sometimes unreliable.
+// can't "Remember" the user's AirPods by any device property.
 //
+// Every address we see is kept as a track in a small open-addressing table. A track is scored on
+// its proximity (smoothed RSSI), and checked for continuity (model and batteries) against the
+// tracks currently locked as ours. The lock of a side only moves to another track if it's
+// continuous with ours after the locked one went silent (i.e. the address is rotated), or if it is
+// clearly closer. The work per advertisement is bounded by the table size.
+//
+// The RSSI of a single packet is noisy, so the `rssi_min` threshold is applied to the smoothed
+// RSSI of a track with hysteresis. A track enters the range at `rssiMin`, and only leaves it when
+// it's `kRssiHysteresis` below.
+//
+class DeviceTracker
+{
+public:
+    constexpr static size_t kCapacity = 32;
+    constexpr static float kRssiSmoothing = 0.3f;
+    constexpr static float kRssiHysteresis = 5.f;
+
+    static float SmoothRssi(float smoothed, int16_t rssi);
+    static bool IsRssiInRange(float smoothed, int16_t rssiMin, bool wasInRange);
+
+    // Returns true if the advertisement is from the track locked as ours for its side
+    //
+    bool Feed(const Advertisement &adv);
+
+    // Refreshes the locked track of the side with repeated advertisements
+    //
+    void RefreshLocked(Side side, float smoothedRssi, Advertisement::Timestamp timestamp);
+
+    std::optional<float> GetLockedRssi(Side side) const;
+    bool IsLocked(Advertisement::AddressType address) const;
+    bool IsLocked(Side side) const;
+
+    // RSSI distance to the closest locked track which the advertisement can be from the same
+    // device as, nullopt if there is no such track
+    //
+    std::optional<float> GetLockedDistance(const Advertisement &adv) const;
+
+    // The address is claimed by another device, never lock onto it
+    //
+    void Exclude(Advertisement::AddressType address);
+
+    void Reset();
+    void OnRssiMinChanged(int16_t rssiMin);
+
+private:
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "The capacity must be a power of 2.");
+
+    struct Track {
+        Advertisement::AddressType address{0}; // 0 if unused
+        Side side{Side::Left};
+        Model model{Model::Unknown};
+        Battery left, right, caseBox;
+        float rssi{0.f}; // Smoothed
+        bool inRange{false};
+        bool excluded{false};
+        uint32_t hits{0};
+        Advertisement::Timestamp lastSeen;
+    };
+
+    std::array<Track, kCapacity> _tracks;
+    Helper::Sides<std::optional<size_t>> _locked;
+    int16_t _rssiMin{std::numeric_limits<int16_t>::max()};
+
+    Track &Lookup(Advertisement::AddressType address);
+    std::optional<size_t> Find(Advertisement::AddressType address) const;
+    bool TryLock(size_t index);
+    bool IsBestCandidate(size_t index, const Track *anotherLocked) const;
+
+    static void AssignState(Track &track, const Advertisement::AdvState &advState);
+    static float Continuity(const Track &lhs, const Track &rhs);
+    static float Proximity(float rssi);
+};
+
+// Online estimate of the drain or charge rate of a battery.
+//
+// The battery is reported in steps of 10%, so a rate is only measured between two consecutive
+// step changes in the same direction, and the rates are smoothed by EWMA. O(1) per sample. The
+// estimate is dropped when the charging state flips or the battery becomes unavailable.
+//
+class DrainEstimator
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    constexpr static float kRateSmoothing = 0.5f;
+
+    void Update(const Battery &battery, bool isCharging, Clock::time_point timestamp);
+
+    std::optional<std::chrono::seconds> GetTimeToEmpty() const;
+    std::optional<std::chrono::seconds> GetTimeToFull() const;
+
+private:
+    std::optional<Battery::ValueType> _value;
+    bool _isCharging{false};
+    std::optional<Clock::time_point> _steppedAt; // The last step change we saw entirely
+    std::optional<float> _rate;                  // Percent per second, negative if draining
+};
+
 class StateManager
 {
 public:
     struct UpdateEvent {
         std::optional<State> oldState;
         State newState;
+        StateFields changedFields{StateField::None};
+    };
+    using FnLost = std::function<void()>;
+
+    // An immutable copy of the current state. `version` is increased every time the state changes,
+    // so readers can skip the work if it's the same as the last one they have seen.
+    //
+    struct Snapshot {
+        uint64_t version{0};
+        std::optional<State> state;
     };
 
     StateManager();
 
-    std::optional<State> GetCurrentState() const;
+    // Invoked with the internal lock held when a known state is dropped, either because the
+    // device is lost or disconnected.
+    //
+    inline auto &CbLost()
+    {
+        return _cbLost;
+    }
 
-    std::optional<UpdateEvent> OnAdvReceived(Advertisement adv);
+    std::optional<State> GetCurrentState() const;
+    std::shared_ptr<const Snapshot> GetSnapshot() const;
+
+    // The state of an `UpdateEvent` isn't published until the owner has filled in the fields it
+    // maintains, so snapshot readers see the same state as the one delivered with the event. It's
+    // ignored if the state has been dropped since then.
+    //
+    void PublishState(const State &state);
+
+    // Lock-free fast path for exact repeats of the last accepted advertisement of a side, which
+    // AirPods broadcast several times a second. Returns true if the advertisement is a repeat and
+    // the smoothed RSSI is still in range, only the timers and the RSSI are refreshed then.
+    // Otherwise `OnAdvReceived` should be called.
+    //
+    bool OnRepeatedAdvReceived(const Advertisement &adv);
+    std::optional<UpdateEvent> OnAdvReceived(const Advertisement &adv);
     void Disconnect();
 
+    // Whether advertisements from the address are currently accepted as ours
+    //
+    bool IsLockedAddress(Advertisement::AddressType address) const;
+    bool IsLockedSide(Side side) const;
+    std::optional<float> GetLockedDistance(const Advertisement &adv) const;
+    void ExcludeAddress(Advertisement::AddressType address);
+
+    // In batching mode, accepted advertisements only replace the freshest candidate of their side,
+    // and the state is reduced from them once per window by calling `Flush`.
+    //
+    void SetBatching(bool enable);
+    std::optional<UpdateEvent> Flush();
+
     void OnRssiMinChanged(int16_t rssiMin);
 
 private:
-    using Clock = std::chrono::steady_clock;
-    using Timestamp = std::chrono::time_point<Clock>;
-
     mutable std::mutex _mutex;
+    Helper::Callback<FnLost> _cbLost;
 
     Helper::Timer _lostTimer;
     Helper::Sides<Helper::Timer> _stateResetTimer;
-    Helper::Sides<std::optional<std::pair<Advertisement, Timestamp>>> _adv;
+    Helper::Sides<std::optional<Advertisement>> _adv;
     std::optional<State> _cachedState;
-    int16_t _rssiMin{std::numeric_limits<int16_t>::max()};
-
-    bool IsPossibleDesiredAdv(const Advertisement &adv) const;
-    void UpdateAdv(Advertisement adv);
+    std::atomic<std::shared_ptr<const Snapshot>> _snapshot{std::make_shared<const Snapshot>()};
+    std::atomic<int16_t> _rssiMin{std::numeric_limits<int16_t>::max()};
+    bool _batching{false}, _batchPending{false};
+    Helper::Sides<std::atomic<uint64_t>> _lastFingerprint;
+    Helper::Sides<std::atomic<float>> _lastRssi; // Smoothed
+    Helper::Sides<std::atomic<Advertisement::Timestamp>> _lastSeen;
+    DeviceTracker _tracker;
+
+    bool IsPossibleDesiredAdv(const Advertisement &adv);
+    void UpdateAdv(const Advertisement &adv);
     std::optional<UpdateEvent> UpdateState();
     void ResetAll();
+    void PublishSnapshot(std::optional<State> state);
 
     void DoLost();
     void DoStateReset(Side side);
 };
 } // namespace Details
 
+// The address of a bound device, events of different devices are distinguished by it
+//
+using DeviceKey = uint64_t;
+
+// Core logic of tracking the bound AirPods. It doesn't depend on the GUI, state events are
+// delivered to the registered callbacks instead. Callbacks are invoked from the Bluetooth and
+// timer threads, consumers are responsible for marshalling them to their own thread.
+//
 class Manager
 {
 public:
+    using FnStateChanged =
+        std::function<void(DeviceKey key, const State &, StateFields changedFields)>;
+    using FnDisconnected = std::function<void(DeviceKey key)>;
+    using FnAvailabilityChanged = std::function<void(bool available)>;
+    using FnLidOpened = std::function<void(DeviceKey key, bool opened)>;
+
+    // The upper bound of devices to be bound at the same time, so the fast path only checks a
+    // handful of them
+    //
+    constexpr static size_t kMaxBoundDevices = 4;
+
     Manager();
 
+    inline auto &CbStateChanged()
+    {
+        return _cbStateChanged;
+    }
+    inline auto &CbDisconnected()
+    {
+        return _cbDisconnected;
+    }
+    inline auto &CbAvailabilityChanged()
+    {
+        return _cbAvailabilityChanged;
+    }
+    inline auto &CbLidOpened()
+    {
+        return _cbLidOpened;
+    }
+
+    // Lock-free, it doesn't contend with the advertisement processing. The state is the same as
+    // the last one delivered by `CbStateChanged`. Returns nullptr if the device isn't bound.
+    //
+    std::shared_ptr<const Details::StateManager::Snapshot> GetSnapshot(DeviceKey key) const;
+
+    // Battery and charging changes of the bound devices are appended to the history in the file
+    //
+    bool OpenBatteryHistory(const std::filesystem::path &path);
+    inline const BatteryHistory::History &GetBatteryHistory() const
+    {
+        return _batteryHistory;
+    }
+
     void StartScanner();
     void StopScanner();
 
     void OnRssiMinChanged(int16_t rssiMin);
+    void OnStateBatchWindowChanged(std::chrono::milliseconds window);
     void OnAutomaticEarDetectionChanged(bool enable);
-    void OnBoundDeviceAddressChanged(uint64_t address);
+
+    // Devices that are still bound keep their states, the others are disconnected
+    //
+    void OnBoundDevicesChanged(const std::vector<uint64_t> &addresses);
 
 private:
+    struct BoundDevice {
+        BoundDevice(DeviceKey key, Bluetooth::Device device);
+
+        const DeviceKey key;
+        Bluetooth::Device device;
+        Model model{Model::Unknown};
+        QString name;
+        std::atomic<bool> connected{false};
+        Details::StateManager stateMgr;
+        Details::DrainEstimator leftDrain, rightDrain, caseDrain;
+    };
+    using BoundDevices = std::vector<std::shared_ptr<BoundDevice>>;
+
+    Helper::Callback<FnStateChanged> _cbStateChanged;
+    Helper::Callback<FnDisconnected> _cbDisconnected;
+    Helper::Callback<FnAvailabilityChanged> _cbAvailabilityChanged;
+    Helper::Callback<FnLidOpened> _cbLidOpened;
+
     std::mutex _mutex;
     Bluetooth::AdvertisementWatcher _adWatcher;
-    Details::StateManager _stateMgr;
-    std::optional<Bluetooth::Device> _boundDevice;
-    QString _deviceName;
-    bool _deviceConnected{false};
+    Helper::Timer _batchTimer;
+    BatteryHistory::History _batteryHistory;
+
+    // Replaced as a whole under `_mutex`, so the fast path can read it without the lock
+    //
+    std::atomic<std::shared_ptr<const BoundDevices>> _devices{
+        std::make_shared<const BoundDevices>()};
+
+    // Advertisement addresses accepted by a device, to the index in `_devices`
+    //
+    std::unordered_map<Details::Advertisement::AddressType, size_t> _routes;
+
+    int16_t _rssiMin{std::numeric_limits<int16_t>::max()};
+    bool _batching{false};
     bool _automaticEarDetection{false};
 
-    void OnBoundDeviceConnectionStateChanged(Bluetooth::DeviceState state);
-    void OnStateChanged(Details::StateManager::UpdateEvent updateEvent);
-    void OnLidOpened(bool opened);
+    void OnBoundDeviceConnectionStateChanged(BoundDevice &device, Bluetooth::DeviceState state);
+    bool OnDeviceAdvReceived(BoundDevice &device, const Details::Advertisement &adv);
+    void OnStateChanged(BoundDevice &device, Details::StateManager::UpdateEvent updateEvent);
+    void OnBatchWindowElapsed();
+    void OnLidStateChanged(
+        DeviceKey key, const std::optional<State> &oldState, const State &newState);
+    void OnLidOpened(DeviceKey key, bool opened);
     void OnBothInEar(bool isBothInEar);
     bool OnAdvertisementReceived(const Bluetooth::AdvertisementWatcher::ReceivedData &data);
     void OnAdvWatcherStateChanged(
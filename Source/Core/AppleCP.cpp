@@ -20,7 +20,7 @@
 #include <cstring>
 namespace Core::AppleCP {
 
-bool AirPods::IsValid(const std::vector<uint8_t> &data)
+bool AirPods::IsValid(std::span<const uint8_t> data)
 {
     if (data.size() != sizeof(AirPods)) {
         return false;
@@ -29,7 +29,7 @@ bool AirPods::IsValid(const std::vector<uint8_t> &data)
     constexpr uint8_t shouldRemainingLength =
         sizeof(AirPods) - (offsetof(Header, remainingLength) + sizeof(Header::remainingLength));
 
-    Header *packet = (Header *)(data.data());
+    const Header *packet = (const Header *)(data.data());
     if (packet->packetType != PacketType::ProximityPairing ||
         packet->remainingLength != shouldRemainingLength)
     {
@@ -41,32 +41,7 @@ bool AirPods::IsValid(const std::vector<uint8_t> &data)
 
 Core::AirPods::Model AirPods::GetModel(uint16_t modelId)
 {
-    switch (modelId) {
-    case 0x2002:
-        return Core::AirPods::Model::AirPods_1;
-    case 0x200F:
-        return Core::AirPods::Model::AirPods_2;
-    case 0x2013:
-        return Core::AirPods::Model::AirPods_3;
-    case 0x200E:
-        return Core::AirPods::Model::AirPods_Pro;
-    case 0x2014:
-        return Core::AirPods::Model::AirPods_Pro_2;
-    case 0x2024:
-        return Core::AirPods::Model::AirPods_Pro_2_USB_C;
-    case 0x200A:
-        return Core::AirPods::Model::AirPods_Max;
-        // case 0x2003:
-        //    return Core::AirPods::Model::Powerbeats_3;
-        // case 0x2005:
-        //    return Core::AirPods::Model::Beats_X;
-        // case 0x2006:
-        //    return Core::AirPods::Model::Beats_Solo3;
-    case 0x2012:
-        return Core::AirPods::Model::Beats_Fit_Pro;
-    default:
-        return Core::AirPods::Model::Unknown;
-    }
+    return Core::AirPods::GetModelByProductId(modelId);
 }
 
 Core::AirPods::Side AirPods::GetBroadcastedSide() const
@@ -18,7 +18,9 @@
 
 #pragma once
 
+#include <span>
 #include <vector>
+#include <iterator>
 
 #include "Base.h"
 
@@ -100,7 +102,9 @@ constexpr uint16_t VendorId = 76;
 class AirPods : Header
 {
 public:
-    static bool IsValid(const std::vector<uint8_t> &data);
+    static constexpr PacketType kPacketType = PacketType::ProximityPairing;
+
+    static bool IsValid(std::span<const uint8_t> data);
     static Core::AirPods::Model GetModel(uint16_t modelId);
 
     Core::AirPods::Side GetBroadcastedSide() const;
@@ -163,13 +167,178 @@ static_assert(sizeof(AirPods) == 27);
 template <class T>
 concept KindOfACPStruct = std::is_base_of_v<Header, T>;
 
+// A non-owning view of an ACP struct inside a received buffer.
+//
+// All ACP structs are packed (alignment 1), so they can be read in place without copying them out
+// of the buffer first. The view is only valid as long as the underlying buffer is alive.
+//
+template <KindOfACPStruct T>
+class View
+{
+public:
+    explicit View(const T *ptr) : _ptr{ptr} {}
+
+    const T *operator->() const
+    {
+        return _ptr;
+    }
+
+    const T &operator*() const
+    {
+        return *_ptr;
+    }
+
+    std::span<const uint8_t> Bytes() const
+    {
+        return {reinterpret_cast<const uint8_t *>(_ptr), sizeof(T)};
+    }
+
+private:
+    const T *_ptr;
+};
+
 template <KindOfACPStruct T>
-std::optional<T> As(const std::vector<uint8_t> &data)
+std::optional<View<T>> ViewAs(std::span<const uint8_t> data)
 {
+    static_assert(alignof(T) == 1);
+    static_assert(std::is_trivially_copyable_v<View<T>>);
+
     if (!T::IsValid(data)) {
         return std::nullopt;
     }
 
-    return *(T *)data.data();
+    return View<T>{reinterpret_cast<const T *>(data.data())};
+}
+
+// The manufacturer data of an Apple advertisement is a sequence of messages (TLVs), each one
+// starts with a `Header`. For example, NearbyInfo and ProximityPairing can be broadcast in the same
+// advertisement.
+//
+struct Message {
+    PacketType type;
+    std::span<const uint8_t> bytes; // The whole message, including the header
+};
+
+// Walks the messages in a single pass without copying. The iteration stops at the first message
+// that is truncated.
+//
+class Messages
+{
+public:
+    class Iterator
+    {
+    public:
+        using difference_type = std::ptrdiff_t;
+        using value_type = Message;
+
+        Iterator() = default;
+        explicit Iterator(std::span<const uint8_t> remaining) : _remaining{remaining}
+        {
+            Check();
+        }
+
+        Message operator*() const
+        {
+            return Message{
+                .type = static_cast<PacketType>(_remaining[offsetof(Header, packetType)]),
+                .bytes = _remaining.first(MessageSize())};
+        }
+
+        Iterator &operator++()
+        {
+            _remaining = _remaining.subspan(MessageSize());
+            Check();
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            auto result = *this;
+            ++*this;
+            return result;
+        }
+
+        bool operator==(std::default_sentinel_t) const
+        {
+            return _remaining.empty();
+        }
+
+    private:
+        std::span<const uint8_t> _remaining;
+
+        size_t MessageSize() const
+        {
+            return sizeof(Header) + _remaining[offsetof(Header, remainingLength)];
+        }
+
+        void Check()
+        {
+            if (_remaining.size() < sizeof(Header) || _remaining.size() < MessageSize()) {
+                _remaining = {};
+            }
+        }
+    };
+
+    explicit Messages(std::span<const uint8_t> payload) : _payload{payload} {}
+
+    Iterator begin() const
+    {
+        return Iterator{_payload};
+    }
+
+    std::default_sentinel_t end() const
+    {
+        return std::default_sentinel;
+    }
+
+private:
+    std::span<const uint8_t> _payload;
+};
+
+template <KindOfACPStruct T>
+std::optional<T> As(std::span<const uint8_t> data)
+{
+    auto view = ViewAs<T>(data);
+    if (!view.has_value()) {
+        return std::nullopt;
+    }
+
+    return **view;
+}
+
+// Finds the first valid message of the type `T` wherever it sits in the payload.
+//
+template <KindOfACPStruct T>
+std::optional<View<T>> Find(std::span<const uint8_t> payload)
+{
+    for (const auto &message : Messages{payload}) {
+        if (message.type != T::kPacketType) {
+            continue;
+        }
+        if (auto view = ViewAs<T>(message.bytes); view.has_value()) {
+            return view;
+        }
+    }
+    return std::nullopt;
+}
+
+// Calls `callback` with a `View<T>` for each valid message in the payload whose type matches one
+// of `Ts`. The decoder to use for each message is selected at compile time.
+//
+template <KindOfACPStruct... Ts, class Callback>
+void Dispatch(std::span<const uint8_t> payload, Callback &&callback)
+{
+    for (const auto &message : Messages{payload}) {
+        (
+            [&] {
+                if (message.type != Ts::kPacketType) {
+                    return;
+                }
+                if (auto view = ViewAs<Ts>(message.bytes); view.has_value()) {
+                    callback(view.value());
+                }
+            }(),
+            ...);
+    }
 }
 } // namespace Core::AppleCP
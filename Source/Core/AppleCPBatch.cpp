@@ -0,0 +1,186 @@
+//
+// AirPodsDesktop - AirPods Desktop User Experience Enhancement Program.
+// Copyright (C) 2021-2022 SpriteOvO
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "AppleCPBatch.h"
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+    #define APD_APPLECP_BATCH_SSE2
+    #include <emmintrin.h>
+#endif
+
+namespace Core::AppleCP::Batch {
+
+namespace {
+
+// Byte offsets of the fields in `AppleCP::AirPods`
+//
+// flags:    bit 1 currInEar, bit 2 bothInCase, bit 3 anotInEar, bit 5 broadcastFrom
+// battery:  bits 0-3 curr, bits 4-7 anot
+// charging: bits 0-3 caseBox, bit 4 currCharging, bit 5 anotCharging, bit 6 caseCharging
+// lid:      bit 3 closed
+//
+constexpr size_t kModelIdOffset = 3;
+constexpr size_t kFlagsOffset = 5;
+constexpr size_t kBatteryOffset = 6;
+constexpr size_t kChargingOffset = 7;
+constexpr size_t kLidOffset = 8;
+
+void DecodeModels(std::span<const Payload> payloads, Decoded &output)
+{
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        const auto &payload = payloads[i];
+        const uint16_t modelId =
+            payload[kModelIdOffset] | (static_cast<uint16_t>(payload[kModelIdOffset + 1]) << 8);
+
+        output.model[i] = Core::AirPods::GetModelByProductId(modelId);
+    }
+}
+
+void DecodeScalar(std::span<const Payload> payloads, Decoded &output, size_t begin)
+{
+    for (size_t i = begin; i < payloads.size(); ++i) {
+        const auto &payload = payloads[i];
+
+        const uint8_t flags = payload[kFlagsOffset];
+        const uint8_t battery = payload[kBatteryOffset];
+        const uint8_t charging = payload[kChargingOffset];
+
+        const bool fromLeft = (flags >> 5) & 1;
+
+        const uint8_t curr = battery & 0x0F, anot = battery >> 4;
+        const uint8_t currCharging = (charging >> 4) & 1, anotCharging = (charging >> 5) & 1;
+        const uint8_t currInEar = (flags >> 1) & 1, anotInEar = (flags >> 3) & 1;
+
+        const uint8_t leftCharging = fromLeft ? currCharging : anotCharging;
+        const uint8_t rightCharging = fromLeft ? anotCharging : currCharging;
+
+        output.leftBattery[i] = fromLeft ? curr : anot;
+        output.rightBattery[i] = fromLeft ? anot : curr;
+        output.caseBattery[i] = charging & 0x0F;
+
+        output.charging[i] = leftCharging * Bit::Left | rightCharging * Bit::Right |
+                             ((charging >> 6) & 1) * Bit::Case;
+
+        output.inEar[i] = ((leftCharging ^ 1) & (fromLeft ? currInEar : anotInEar)) * Bit::Left |
+                          ((rightCharging ^ 1) & (fromLeft ? anotInEar : currInEar)) * Bit::Right;
+
+        output.lidOpened[i] = ((payload[kLidOffset] >> 3) & 1) ^ 1;
+    }
+}
+
+#if defined APD_APPLECP_BATCH_SSE2
+size_t DecodeSse2(std::span<const Payload> payloads, Decoded &output)
+{
+    constexpr size_t kLanes = sizeof(__m128i);
+
+    const auto select = [](__m128i mask, __m128i ifTrue, __m128i ifFalse) {
+        return _mm_or_si128(_mm_and_si128(mask, ifTrue), _mm_andnot_si128(mask, ifFalse));
+    };
+    // There is no 8-bit shift in SSE2, shift 16-bit lanes and mask the bits that crossed over
+    //
+    const auto bitAt = [](__m128i value, int bit) {
+        return _mm_and_si128(_mm_srli_epi16(value, bit), _mm_set1_epi8(1));
+    };
+
+    const auto lowNibble = _mm_set1_epi8(0x0F);
+    const auto broadcastFrom = _mm_set1_epi8(0x20);
+
+    size_t i = 0;
+    for (; i + kLanes <= payloads.size(); i += kLanes) {
+        alignas(kLanes) uint8_t flagsLanes[kLanes], batteryLanes[kLanes],
+            chargingLanes[kLanes], lidLanes[kLanes];
+
+        // Transpose the packed records into lanes
+        //
+        for (size_t lane = 0; lane < kLanes; ++lane) {
+            const auto &payload = payloads[i + lane];
+            flagsLanes[lane] = payload[kFlagsOffset];
+            batteryLanes[lane] = payload[kBatteryOffset];
+            chargingLanes[lane] = payload[kChargingOffset];
+            lidLanes[lane] = payload[kLidOffset];
+        }
+
+        const auto flags = _mm_load_si128(reinterpret_cast<const __m128i *>(flagsLanes));
+        const auto battery = _mm_load_si128(reinterpret_cast<const __m128i *>(batteryLanes));
+        const auto charging = _mm_load_si128(reinterpret_cast<const __m128i *>(chargingLanes));
+        const auto lid = _mm_load_si128(reinterpret_cast<const __m128i *>(lidLanes));
+
+        const auto fromLeft = _mm_cmpeq_epi8(_mm_and_si128(flags, broadcastFrom), broadcastFrom);
+
+        const auto curr = _mm_and_si128(battery, lowNibble);
+        const auto anot = _mm_and_si128(_mm_srli_epi16(battery, 4), lowNibble);
+
+        const auto currCharging = bitAt(charging, 4), anotCharging = bitAt(charging, 5);
+        const auto currInEar = bitAt(flags, 1), anotInEar = bitAt(flags, 3);
+
+        const auto leftCharging = select(fromLeft, currCharging, anotCharging);
+        const auto rightCharging = select(fromLeft, anotCharging, currCharging);
+
+        // Bit::Left == 1, Bit::Right == 2, Bit::Case == 4
+        //
+        const auto chargingBits = _mm_or_si128(
+            _mm_or_si128(leftCharging, _mm_slli_epi16(rightCharging, 1)),
+            _mm_slli_epi16(bitAt(charging, 6), 2));
+
+        const auto leftInEar =
+            _mm_andnot_si128(leftCharging, select(fromLeft, currInEar, anotInEar));
+        const auto rightInEar =
+            _mm_andnot_si128(rightCharging, select(fromLeft, anotInEar, currInEar));
+        const auto inEarBits = _mm_or_si128(leftInEar, _mm_slli_epi16(rightInEar, 1));
+
+        const auto lidOpened = _mm_xor_si128(bitAt(lid, 3), _mm_set1_epi8(1));
+
+        const auto store = [i](std::vector<uint8_t> &to, __m128i value) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(to.data() + i), value);
+        };
+
+        store(output.leftBattery, select(fromLeft, curr, anot));
+        store(output.rightBattery, select(fromLeft, anot, curr));
+        store(output.caseBattery, _mm_and_si128(charging, lowNibble));
+        store(output.charging, chargingBits);
+        store(output.inEar, inEarBits);
+        store(output.lidOpened, lidOpened);
+    }
+
+    return i;
+}
+#endif
+} // namespace
+
+void Decode(std::span<const Payload> payloads, Decoded &output)
+{
+    const auto size = payloads.size();
+
+    output.model.resize(size);
+    output.leftBattery.resize(size);
+    output.rightBattery.resize(size);
+    output.caseBattery.resize(size);
+    output.charging.resize(size);
+    output.inEar.resize(size);
+    output.lidOpened.resize(size);
+
+    DecodeModels(payloads, output);
+
+    size_t decoded = 0;
+#if defined APD_APPLECP_BATCH_SSE2
+    decoded = DecodeSse2(payloads, output);
+#endif
+    DecodeScalar(payloads, output, decoded);
+}
+
+} // namespace Core::AppleCP::Batch
@@ -0,0 +1,66 @@
+//
+// AirPodsDesktop - AirPods Desktop User Experience Enhancement Program.
+// Copyright (C) 2021-2022 SpriteOvO
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <array>
+#include <span>
+#include <vector>
+
+#include "AppleCP.h"
+
+// Batch decoder for replaying captured advertisement streams.
+//
+// `AppleCP::AirPods` decodes the bitfields of one packet at a time, which is fine for live
+// scanning but slow for millions of captured packets. Here the fields of many packets are decoded
+// at once into a structure of arrays, so the nibble and bit extraction can be vectorized.
+//
+namespace Core::AppleCP::Batch {
+
+using Payload = std::array<uint8_t, sizeof(AirPods)>;
+
+enum Bit : uint8_t {
+    Left = 1 << 0,
+    Right = 1 << 1,
+    Case = 1 << 2,
+};
+
+struct Decoded {
+    std::vector<Core::AirPods::Model> model;
+
+    // Battery remaining [0, 10], otherwise unavailable
+    std::vector<uint8_t> leftBattery;
+    std::vector<uint8_t> rightBattery;
+    std::vector<uint8_t> caseBattery;
+
+    std::vector<uint8_t> charging; // Combination of `Bit`
+    std::vector<uint8_t> inEar;    // Combination of `Bit::Left` and `Bit::Right`
+    std::vector<uint8_t> lidOpened;
+
+    inline size_t Size() const
+    {
+        return model.size();
+    }
+};
+
+// The payloads are expected to be validated by `AirPods::IsValid` beforehand.
+// The results are the same as the accessors of `AirPods` would return for each payload.
+//
+void Decode(std::span<const Payload> payloads, Decoded &output);
+
+} // namespace Core::AppleCP::Batch
@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <array>
 #include <optional>
 
 #include "../Helper.h"
@@ -81,37 +82,94 @@ enum class Model : uint32_t {
 
 enum class Side : uint32_t { Left, Right };
 
+//
+// Model registry
+//
+// Every per-model property lives in this table. To add a model, add an enumerator to `Model` and
+// a row here, the protocol decoder and the GUI read from the same table.
+//
+
+struct ModelInfo {
+    Model model;
+    uint16_t productId; // Product ID in advertisements and device properties, 0 if unrecognized
+    const char *displayName;
+    const char *media;
+    // It's not possible to set video padding background color or get video resolution just
+    // through Qt, so we hardcode it here
+    uint16_t videoWidth, videoHeight;
+};
+
+namespace Details {
+
+// clang-format off
+constexpr inline std::array<ModelInfo, Helper::ToUnderlying(Model::_Max)> kModelInfos = {{
+    {Model::Unknown,             0x0000, "Unknown",               "qrc:/Resource/Video/AirPods_1.avi",     800, 400},
+    {Model::AirPods_1,           0x2002, "AirPods 1",             "qrc:/Resource/Video/AirPods_1.avi",     800, 400},
+    {Model::AirPods_2,           0x200F, "AirPods 2",             "qrc:/Resource/Video/AirPods_2.avi",     800, 400},
+    {Model::AirPods_3,           0x2013, "AirPods 3",             "qrc:/Resource/Video/AirPods_3.avi",     900, 450},
+    {Model::AirPods_Pro,         0x200E, "AirPods Pro",           "qrc:/Resource/Video/AirPods_Pro.avi",   900, 450},
+    {Model::AirPods_Pro_2,       0x2014, "AirPods Pro 2",         "qrc:/Resource/Video/AirPods_Pro_2.avi", 900, 450},
+    {Model::AirPods_Pro_2_USB_C, 0x2024, "AirPods Pro 2 (USB-C)", "qrc:/Resource/Video/AirPods_Pro_2.avi", 900, 450},
+    {Model::AirPods_Max,         0x200A, "AirPods Max",           "qrc:/Resource/Video/AirPods_Max.avi",   600, 650},
+    {Model::Powerbeats_3,        0x0000, "Powerbeats 3",          "qrc:/Resource/Video/AirPods_1.avi",     800, 400}, // 0x2003
+    {Model::Beats_X,             0x0000, "BeatsX",                "qrc:/Resource/Video/AirPods_1.avi",     800, 400}, // 0x2005
+    {Model::Beats_Solo3,         0x0000, "BeatsSolo3",            "qrc:/Resource/Video/AirPods_1.avi",     800, 400}, // 0x2006
+    {Model::Beats_Fit_Pro,       0x2012, "Beats Fit Pro",         "qrc:/Resource/Video/Beats_Fit_Pro.avi", 900, 450},
+}};
+// clang-format on
+
+// All known product IDs share the high byte, so the low byte is a perfect hash of them
+//
+constexpr inline uint16_t kProductIdPrefix = 0x2000;
+
+constexpr inline auto kModelByProductIdLowByte = [] {
+    std::array<Model, 0x100> result{};
+    result.fill(Model::Unknown);
+
+    for (const auto &info : kModelInfos) {
+        if (info.productId == 0) {
+            continue;
+        }
+        if ((info.productId & 0xFF00) != kProductIdPrefix ||
+            result[info.productId & 0xFF] != Model::Unknown)
+        {
+            throw "The product IDs can no longer be hashed by the low byte.";
+        }
+        result[info.productId & 0xFF] = info.model;
+    }
+    return result;
+}();
+
+static_assert([] {
+    for (size_t i = 0; i < kModelInfos.size(); ++i) {
+        if (Helper::ToUnderlying(kModelInfos[i].model) != i) {
+            return false;
+        }
+    }
+    return true;
+}(), "The rows of `kModelInfos` must be in the same order as `Model`.");
+} // namespace Details
+
+constexpr const ModelInfo &GetModelInfo(Model model)
+{
+    const auto index = Helper::ToUnderlying(model);
+    return Details::kModelInfos[index < Details::kModelInfos.size() ? index : 0];
+}
+
+constexpr Model GetModelByProductId(uint16_t productId)
+{
+    if ((productId & 0xFF00) != Details::kProductIdPrefix) {
+        return Model::Unknown;
+    }
+    return Details::kModelByProductIdLowByte[productId & 0xFF];
+}
+
 } // namespace Core::AirPods
 
 template <>
 inline QString Helper::ToString<Core::AirPods::Model>(const Core::AirPods::Model &value)
 {
-    switch (value) {
-    case Core::AirPods::Model::AirPods_1:
-        return "AirPods 1";
-    case Core::AirPods::Model::AirPods_2:
-        return "AirPods 2";
-    case Core::AirPods::Model::AirPods_3:
-        return "AirPods 3";
-    case Core::AirPods::Model::AirPods_Pro:
-        return "AirPods Pro";
-    case Core::AirPods::Model::AirPods_Pro_2:
-        return "AirPods Pro 2";
-    case Core::AirPods::Model::AirPods_Pro_2_USB_C:
-        return "AirPods Pro 2 (USB-C)";
-    case Core::AirPods::Model::AirPods_Max:
-        return "AirPods Max";
-    case Core::AirPods::Model::Powerbeats_3:
-        return "Powerbeats 3";
-    case Core::AirPods::Model::Beats_X:
-        return "BeatsX";
-    case Core::AirPods::Model::Beats_Solo3:
-        return "BeatsSolo3";
-    case Core::AirPods::Model::Beats_Fit_Pro:
-        return "Beats Fit Pro";
-    default:
-        return "Unknown";
-    }
+    return Core::AirPods::GetModelInfo(value).displayName;
 }
 
 template <>
@@ -0,0 +1,338 @@
+//
+// AirPodsDesktop - AirPods Desktop User Experience Enhancement Program.
+// Copyright (C) 2021-2022 SpriteOvO
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "BatteryHistory.h"
+
+#include <array>
+#include <algorithm>
+
+#if defined APD_OS_WIN
+    #include "OS/Windows.h"
+#else
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+// #include "../Logger.h"
+
+namespace Core::BatteryHistory {
+
+// The layout of the file, which is mapped as is. Fields are fixed-width and naturally aligned so
+// that the layout doesn't depend on the compiler.
+//
+struct History::FileHeader {
+    constexpr static uint32_t kMagic = 0x48425041; // "APBH"
+    constexpr static uint32_t kVersion = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    uint64_t count; // Total appended, the next record is written at `count % capacity`
+};
+
+struct History::Record {
+    int64_t time; // Milliseconds since epoch
+    uint64_t key;
+    uint8_t left, right, caseBox; // `kUnavailableBattery` if unavailable
+    uint8_t charging;
+    uint8_t reserved[4];
+};
+
+namespace {
+
+constexpr uint8_t kUnavailableBattery = 0xFF;
+
+// Returns the view of the whole file resized to `size`, or nullptr on failure.
+// `resized` is set if the file didn't have the size, its contents should be reset then.
+//
+void *MapFile(const std::filesystem::path &path, size_t size, bool &resized)
+{
+#if defined APD_OS_WIN
+    HANDLE file = CreateFileW(
+        path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        // LOG(Warn, "BatteryHistory: CreateFileW() failed. Error: {}", GetLastError());
+        return nullptr;
+    }
+
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    resized = static_cast<size_t>(fileSize.QuadPart) != size;
+    if (resized) {
+        LARGE_INTEGER newSize{};
+        newSize.QuadPart = static_cast<LONGLONG>(size);
+        if (!SetFilePointerEx(file, newSize, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) {
+            CloseHandle(file);
+            return nullptr;
+        }
+    }
+
+    // The view holds references to the mapping and the file, the handles can be closed
+    //
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        // LOG(Warn, "BatteryHistory: CreateFileMappingW() failed. Error: {}", GetLastError());
+        return nullptr;
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    CloseHandle(mapping);
+    return view;
+#else
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        // LOG(Warn, "BatteryHistory: open() failed. errno: {}", errno);
+        return nullptr;
+    }
+
+    struct stat fileStat {};
+    if (fstat(fd, &fileStat) != 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    const auto fileSize = static_cast<size_t>(fileStat.st_size);
+    resized = fileSize != size;
+    if (fileSize > size && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    // Every append writes through the view, a sparse file would raise SIGBUS on the first write
+    // to a page the disk has no room for. So the blocks are reserved up front, on file systems
+    // that support it.
+    //
+    const int error = posix_fallocate(fd, 0, static_cast<off_t>(size));
+    if (error == EINVAL || error == EOPNOTSUPP) {
+        if (resized && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            close(fd);
+            return nullptr;
+        }
+    }
+    else if (error != 0) {
+        // LOG(Warn, "BatteryHistory: posix_fallocate() failed. errno: {}", error);
+        close(fd);
+        return nullptr;
+    }
+
+    // The mapping holds a reference to the file, the descriptor can be closed
+    //
+    void *view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        // LOG(Warn, "BatteryHistory: mmap() failed. errno: {}", errno);
+        return nullptr;
+    }
+    return view;
+#endif
+}
+
+void UnmapFile(void *view, size_t size)
+{
+#if defined APD_OS_WIN
+    FlushViewOfFile(view, size);
+    UnmapViewOfFile(view);
+#else
+    msync(view, size, MS_SYNC);
+    munmap(view, size);
+#endif
+}
+
+uint8_t EncodeBattery(const AirPods::Battery &battery)
+{
+    return battery.Available() ? static_cast<uint8_t>(battery.Value()) : kUnavailableBattery;
+}
+
+int64_t ToMilliseconds(Clock::time_point time)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+}
+
+} // namespace
+
+History::~History()
+{
+    Close();
+}
+
+bool History::Open(const std::filesystem::path &path, size_t capacity)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+
+    Unmap();
+
+    if (capacity == 0) {
+        return false;
+    }
+
+    const size_t size = sizeof(FileHeader) + sizeof(Record) * capacity;
+
+    bool resized = false;
+    void *view = MapFile(path, size, resized);
+    if (view == nullptr) {
+        return false;
+    }
+
+    _view = view;
+    _viewSize = size;
+    _header = static_cast<FileHeader *>(view);
+    _records = reinterpret_cast<Record *>(static_cast<std::byte *>(view) + sizeof(FileHeader));
+
+    if (resized || _header->magic != FileHeader::kMagic ||
+        _header->version != FileHeader::kVersion || _header->capacity != capacity)
+    {
+        // LOG(Info, "BatteryHistory: The file is reset.");
+        *_header = FileHeader{
+            .magic = FileHeader::kMagic,
+            .version = FileHeader::kVersion,
+            .capacity = capacity,
+            .count = 0};
+    }
+    return true;
+}
+
+void History::Close()
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    Unmap();
+}
+
+bool History::IsOpened() const
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    return _view != nullptr;
+}
+
+void History::Append(const Sample &sample)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+
+    if (_view == nullptr) {
+        return;
+    }
+
+    auto &record = _records[_header->count % _header->capacity];
+    record = Record{
+        .time = ToMilliseconds(sample.time),
+        .key = sample.key,
+        .left = EncodeBattery(sample.left),
+        .right = EncodeBattery(sample.right),
+        .caseBox = EncodeBattery(sample.caseBox),
+        .charging = sample.charging,
+        .reserved = {}};
+
+    // Published after the record is written, so a crash in between loses only this sample
+    //
+    _header->count += 1;
+}
+
+std::vector<Sample> History::Query(
+    uint64_t key, Clock::time_point from, Clock::time_point to, size_t maxPoints) const
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+
+    std::vector<Sample> result;
+    if (_view == nullptr || maxPoints == 0 || from >= to) {
+        return result;
+    }
+
+    const int64_t fromMs = ToMilliseconds(from), toMs = ToMilliseconds(to);
+    const auto points = static_cast<int64_t>(maxPoints);
+    const int64_t bucketWidth = std::max<int64_t>((toMs - fromMs + points - 1) / points, 1);
+
+    // Records are in the order they were appended, which isn't chronological if the clock was
+    // set back, so they are accumulated into the buckets by index first
+    //
+    struct Bucket {
+        int64_t time{0};
+        std::array<uint32_t, 3> sum{}, count{};
+        uint8_t charging{0};
+        bool empty{true};
+    };
+    const int64_t bucketCount = (toMs - fromMs + bucketWidth - 1) / bucketWidth;
+    std::vector<Bucket> buckets(static_cast<size_t>(bucketCount));
+
+    const uint64_t count = _header->count, capacity = _header->capacity;
+    const uint64_t begin = count > capacity ? count - capacity : 0;
+
+    for (uint64_t i = begin; i < count; ++i) {
+        const auto &record = _records[i % capacity];
+        if (record.key != key || record.time < fromMs || record.time >= toMs) {
+            continue;
+        }
+
+        auto &bucket = buckets[static_cast<size_t>((record.time - fromMs) / bucketWidth)];
+
+        const std::array<uint8_t, 3> batteries{record.left, record.right, record.caseBox};
+        for (size_t b = 0; b < batteries.size(); ++b) {
+            if (batteries[b] != kUnavailableBattery) {
+                bucket.sum[b] += batteries[b];
+                bucket.count[b] += 1;
+            }
+        }
+        bucket.charging |= record.charging;
+        bucket.time = bucket.empty ? record.time : std::max(bucket.time, record.time);
+        bucket.empty = false;
+    }
+
+    for (const auto &bucket : buckets) {
+        if (bucket.empty) {
+            continue;
+        }
+
+        const auto average = [&](size_t i) {
+            return bucket.count[i] != 0
+                       ? AirPods::Battery{(bucket.sum[i] + bucket.count[i] / 2) / bucket.count[i]}
+                       : AirPods::Battery{};
+        };
+
+        result.push_back(Sample{
+            .time = Clock::time_point{std::chrono::milliseconds{bucket.time}},
+            .key = key,
+            .left = average(0),
+            .right = average(1),
+            .caseBox = average(2),
+            .charging = bucket.charging});
+    }
+
+    return result;
+}
+
+void History::Unmap()
+{
+    if (_view == nullptr) {
+        return;
+    }
+
+    UnmapFile(_view, _viewSize);
+    _view = nullptr;
+    _viewSize = 0;
+    _header = nullptr;
+    _records = nullptr;
+}
+
+} // namespace Core::BatteryHistory
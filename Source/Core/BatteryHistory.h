@@ -0,0 +1,93 @@
+//
+// AirPodsDesktop - AirPods Desktop User Experience Enhancement Program.
+// Copyright (C) 2021-2022 SpriteOvO
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <filesystem>
+
+#include "Base.h"
+
+// Battery history of the bound devices.
+//
+// Samples are kept in a fixed-size ring buffer in a memory-mapped file, so the history survives
+// restarts, its size is bounded, and appending is just a copy into the mapped view.
+//
+namespace Core::BatteryHistory {
+
+using Clock = std::chrono::system_clock;
+
+enum Bit : uint8_t {
+    Left = 1 << 0,
+    Right = 1 << 1,
+    Case = 1 << 2,
+};
+
+struct Sample {
+    Clock::time_point time;
+    uint64_t key{0}; // The device which the sample is from
+    AirPods::Battery left, right, caseBox;
+    uint8_t charging{0}; // Combination of `Bit`
+};
+
+class History
+{
+public:
+    constexpr static size_t kDefaultCapacity = 1 << 14;
+
+    History() = default;
+    ~History();
+
+    History(const History &) = delete;
+    History &operator=(const History &) = delete;
+
+    // Maps the file, which is created or reset if it doesn't hold a history of the capacity.
+    // Returns false if the file can't be mapped, appending does nothing then.
+    //
+    bool Open(const std::filesystem::path &path, size_t capacity = kDefaultCapacity);
+    void Close();
+
+    bool IsOpened() const;
+
+    // Overwrites the oldest sample when the buffer is full, never allocates
+    //
+    void Append(const Sample &sample);
+
+    // Samples of the device within [from, to) in chronological order. The range is divided into
+    // `maxPoints` buckets evenly, and each non-empty bucket is reduced into one sample, which has
+    // the average batteries, the charging bits of any sample and the time of the latest sample.
+    //
+    std::vector<Sample>
+    Query(uint64_t key, Clock::time_point from, Clock::time_point to, size_t maxPoints) const;
+
+private:
+    struct FileHeader;
+    struct Record;
+
+    mutable std::mutex _mutex;
+    void *_view{nullptr};
+    size_t _viewSize{0};
+    FileHeader *_header{nullptr};
+    Record *_records{nullptr};
+
+    void Unmap();
+};
+
+} // namespace Core::BatteryHistory
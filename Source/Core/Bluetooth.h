@@ -22,6 +22,9 @@
     #include "Bluetooth_win.h"
 #else
     #include "Bluetooth_linux.h"
+    #if defined APD_BLUETOOTH_HCI
+        #include "Bluetooth_hci.h"
+    #endif
 #endif
 
 template <>
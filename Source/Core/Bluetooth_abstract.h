@@ -20,10 +20,8 @@
 
 #include <functional>
 #include <map>
+#include <span>
 #include "../Helper.h"
-#include <bluetooth/bluetooth.h>
-#include <bluetooth/hci.h>
-#include <bluetooth/hci_lib.h>
 
 namespace Core::Bluetooth {
 
@@ -88,9 +86,19 @@ public:
     };
     using FnReceived = std::function<void(const ReceivedData &)>;
     using FnStateChanged = std::function<void(State, const std::optional<std::string> &)>;
+    using FnFilter = std::function<bool(uint16_t companyId, std::span<const uint8_t> data)>;
 
     virtual inline ~AdvertisementWatcherAbstract() {}
 
+    // The filter is applied to the raw manufacturer data before `ReceivedData` is built.
+    // Advertisements without any accepted manufacturer data are dropped without allocating and
+    // `CbReceived` is not invoked for them. Set it before `Start()`.
+    //
+    inline void SetFilter(FnFilter filter)
+    {
+        _filter = std::move(filter);
+    }
+
     inline auto &CbReceived()
     {
         return _cbReceived;
@@ -103,9 +111,16 @@ public:
     virtual bool Start() = 0;
     virtual bool Stop() = 0;
 
+protected:
+    inline bool Filter(uint16_t companyId, std::span<const uint8_t> data) const
+    {
+        return !_filter || _filter(companyId, data);
+    }
+
 private:
     Helper::Callback<FnReceived> _cbReceived;
     Helper::Callback<FnStateChanged> _cbStateChanged;
+    FnFilter _filter;
 };
 } // namespace Details
 } // namespace Core::Bluetooth
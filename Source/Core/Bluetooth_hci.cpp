@@ -0,0 +1,392 @@
+//
+// AirPodsDesktop - AirPods Desktop User Experience Enhancement Program.
+// Copyright (C) 2021-2022 SpriteOvO
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Bluetooth_hci.h"
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/hci_lib.h>
+
+// #include "../Logger.h"
+#include "Debug.h"
+
+namespace Core::Bluetooth {
+
+//////////////////////////////////////////////////
+// HCI events
+//
+
+namespace Details::Hci {
+namespace {
+
+// Bluetooth Core Specification, Vol 4, Part E, 5.4.4 and 7.7.65
+//
+constexpr uint8_t kEventPacket = 0x04;
+constexpr uint8_t kLeMetaEvent = 0x3E;
+constexpr uint8_t kLeAdvertisingReport = 0x02;
+constexpr uint8_t kLeExtendedAdvertisingReport = 0x0D;
+
+// The least significant byte comes first
+//
+uint64_t ReadAddress(std::span<const uint8_t> bytes)
+{
+    uint64_t address = 0;
+    for (size_t i = 6; i-- > 0;) {
+        address = address << 8 | bytes[i];
+    }
+    return address;
+}
+
+// The fields of each report are read one report after another, as the kernel does
+//
+bool ParseAdvertisingReports(
+    std::span<const uint8_t> params, std::vector<AdvertisingReport> &reports)
+{
+    // Event_Type, Address_Type, Address[6], Data_Length, followed by Data and RSSI
+    //
+    constexpr size_t kHeaderSize = 9;
+
+    const size_t count = params[0];
+    params = params.subspan(1);
+
+    for (size_t i = 0; i < count; ++i) {
+        if (params.size() < kHeaderSize) {
+            return false;
+        }
+
+        const size_t dataLength = params[8];
+        if (params.size() < kHeaderSize + dataLength + 1) {
+            return false;
+        }
+
+        reports.push_back(AdvertisingReport{
+            .address = ReadAddress(params.subspan(2, 6)),
+            .rssi = static_cast<int8_t>(params[kHeaderSize + dataLength]),
+            .status = DataStatus::Complete,
+            .data = params.subspan(kHeaderSize, dataLength)});
+
+        params = params.subspan(kHeaderSize + dataLength + 1);
+    }
+    return true;
+}
+
+bool ParseExtendedAdvertisingReports(
+    std::span<const uint8_t> params, std::vector<AdvertisingReport> &reports)
+{
+    // Event_Type[2], Address_Type, Address[6], Primary_PHY, Secondary_PHY, Advertising_SID,
+    // TX_Power, RSSI, Periodic_Advertising_Interval[2], Direct_Address_Type, Direct_Address[6],
+    // Data_Length, followed by Data
+    //
+    constexpr size_t kHeaderSize = 24;
+    constexpr size_t kDataStatusShift = 5;
+
+    const size_t count = params[0];
+    params = params.subspan(1);
+
+    for (size_t i = 0; i < count; ++i) {
+        if (params.size() < kHeaderSize) {
+            return false;
+        }
+
+        const size_t dataLength = params[23];
+        if (params.size() < kHeaderSize + dataLength) {
+            return false;
+        }
+
+        // The data status is in bits 5 and 6 of the event type, 0b11 is reserved
+        //
+        const auto eventType = static_cast<uint16_t>(params[0] | params[1] << 8);
+        const auto dataStatus = eventType >> kDataStatusShift & 0b11;
+        if (dataStatus == 0b11) {
+            return false;
+        }
+
+        reports.push_back(AdvertisingReport{
+            .address = ReadAddress(params.subspan(3, 6)),
+            .rssi = static_cast<int8_t>(params[13]),
+            .status = static_cast<DataStatus>(dataStatus),
+            .data = params.subspan(kHeaderSize, dataLength)});
+
+        params = params.subspan(kHeaderSize + dataLength);
+    }
+    return true;
+}
+} // namespace
+
+bool ParseEvent(std::span<const uint8_t> packet, std::vector<AdvertisingReport> &reports)
+{
+    reports.clear();
+
+    // Packet_Type, Event_Code, Parameter_Total_Length, Subevent_Code, followed by Num_Reports
+    //
+    if (packet.size() < 5 || packet[0] != kEventPacket || packet[1] != kLeMetaEvent) {
+        return false;
+    }
+
+    const size_t length = packet[2];
+    if (length < 2 || packet.size() < 3 + length) {
+        return false;
+    }
+
+    const auto params = packet.subspan(4, length - 1);
+
+    switch (packet[3]) {
+    case kLeAdvertisingReport:
+        return ParseAdvertisingReports(params, reports);
+    case kLeExtendedAdvertisingReport:
+        return ParseExtendedAdvertisingReports(params, reports);
+    default:
+        return false;
+    }
+}
+} // namespace Details::Hci
+
+//////////////////////////////////////////////////
+// AdvertisementWatcher
+//
+
+namespace {
+
+constexpr int kCommandTimeoutMs = 1000;
+
+// 10 ms in units of 0.625 ms, the window equals the interval to scan continuously
+//
+constexpr uint16_t kScanInterval = 0x0010;
+
+// Packet_Type, Event_Code, Parameter_Total_Length and at most 255 bytes of parameters
+//
+constexpr size_t kMaxEventSize = 3 + 255;
+
+std::string ErrnoMessage(const char *function)
+{
+    return std::string{function} + " failed. " + std::strerror(errno);
+}
+} // namespace
+
+AdvertisementWatcher::AdvertisementWatcher() : _ownsSocket{true} {}
+
+AdvertisementWatcher::AdvertisementWatcher(int socket) : _ownsSocket{false}, _socket{socket} {}
+
+AdvertisementWatcher::~AdvertisementWatcher()
+{
+    Stop();
+}
+
+bool AdvertisementWatcher::Start()
+{
+    if (!_stop) {
+        return true;
+    }
+
+    // The thread may have exited by an error
+    //
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+
+    if (_ownsSocket) {
+        CloseDevice();
+
+        const auto optError = OpenDevice();
+        if (optError.has_value()) {
+            CbStateChanged().Invoke(State::Stopped, optError);
+            return false;
+        }
+    }
+
+    _stop = false;
+    CbStateChanged().Invoke(State::Started, std::nullopt);
+
+    _thread = std::thread{&AdvertisementWatcher::Thread, this};
+    return true;
+}
+
+bool AdvertisementWatcher::Stop()
+{
+    const bool stopped = _stop.exchange(true);
+
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    if (_ownsSocket) {
+        CloseDevice();
+    }
+
+    if (!stopped) {
+        CbStateChanged().Invoke(State::Stopped, std::nullopt);
+    }
+    return true;
+}
+
+std::optional<std::string> AdvertisementWatcher::OpenDevice()
+{
+    const int deviceId = hci_get_route(nullptr);
+    if (deviceId < 0) {
+        return "No Bluetooth adapter found.";
+    }
+
+    _socket = hci_open_dev(deviceId);
+    if (_socket < 0) {
+        return ErrnoMessage("hci_open_dev()");
+    }
+
+    // Only the LE meta events are delivered to the socket
+    //
+    hci_filter filter;
+    hci_filter_clear(&filter);
+    hci_filter_set_ptype(HCI_EVENT_PKT, &filter);
+    hci_filter_set_event(EVT_LE_META_EVENT, &filter);
+
+    if (setsockopt(_socket, SOL_HCI, HCI_FILTER, &filter, sizeof(filter)) != 0) {
+        auto error = ErrnoMessage("setsockopt()");
+        CloseDevice();
+        return error;
+    }
+
+    // Fails if the controller is already scanning, e.g. for bluetoothd. The reports of that scan
+    // are delivered to every raw socket as well, so it's not an error.
+    //
+    _scanEnabled =
+        hci_le_set_scan_parameters(
+            _socket, 0x00 /* Passive */, htobs(kScanInterval), htobs(kScanInterval),
+            LE_PUBLIC_ADDRESS, 0x00 /* Accept all */, kCommandTimeoutMs) == 0 &&
+        hci_le_set_scan_enable(_socket, 0x01, 0x00 /* Report duplicates */, kCommandTimeoutMs) ==
+            0;
+
+    if (!_scanEnabled) {
+        // LOG(Info, "HCI scan isn't enabled, reading the reports of the ongoing scan.");
+    }
+    return std::nullopt;
+}
+
+void AdvertisementWatcher::CloseDevice()
+{
+    if (_socket < 0) {
+        return;
+    }
+
+    if (_scanEnabled) {
+        hci_le_set_scan_enable(_socket, 0x00, 0x00, kCommandTimeoutMs);
+        _scanEnabled = false;
+    }
+
+    hci_close_dev(_socket);
+    _socket = -1;
+}
+
+void AdvertisementWatcher::Thread()
+{
+    std::array<uint8_t, kMaxEventSize> buffer;
+
+    while (!_stop) {
+        pollfd pollFd{.fd = _socket, .events = POLLIN, .revents = 0};
+
+        const int ready = poll(&pollFd, 1, static_cast<int>(kPollInterval.count()));
+        if (ready == 0 || (ready < 0 && errno == EINTR)) {
+            continue;
+        }
+
+        const ssize_t length = ready > 0 ? read(_socket, buffer.data(), buffer.size()) : -1;
+        if (length > 0) {
+            OnEvent({buffer.data(), static_cast<size_t>(length)});
+            continue;
+        }
+        if (length < 0 && (errno == EINTR || errno == EAGAIN)) {
+            continue;
+        }
+
+        auto error =
+            length == 0 ? std::string{"The HCI socket is closed."} : ErrnoMessage("read()");
+        if (!_stop.exchange(true)) {
+            CbStateChanged().Invoke(State::Stopped, error);
+        }
+        return;
+    }
+}
+
+void AdvertisementWatcher::OnEvent(std::span<const uint8_t> packet)
+{
+    if (!Details::Hci::ParseEvent(packet, _reports)) {
+        return;
+    }
+
+    const auto timestamp = std::chrono::system_clock::now();
+
+    for (const auto &report : _reports) {
+        // Fragmented advertisements are dropped, the ones we are interested in are short. The last
+        // fragment is reported as complete, it's recognized by the address.
+        //
+        if (report.status == Details::Hci::DataStatus::Incomplete) {
+            // Forgets the chains whose last fragment was lost
+            //
+            if (_fragmented.size() >= kMaxFragmented) {
+                _fragmented.clear();
+            }
+            _fragmented.insert(report.address);
+            continue;
+        }
+        if (report.status == Details::Hci::DataStatus::Truncated) {
+            _fragmented.erase(report.address);
+            continue;
+        }
+        if ((!_fragmented.empty() && _fragmented.erase(report.address) != 0) ||
+            report.rssi == Details::Hci::kRssiUnavailable)
+        {
+            continue;
+        }
+
+        std::optional<ReceivedData> receivedData;
+
+        Details::Hci::ForEachManufacturerData(
+            report.data, [&](uint16_t companyId, std::span<const uint8_t> bytes) {
+#if defined APD_DEBUG
+                auto overrideAdv = DebugConfig::GetInstance().GetOverrideAdv();
+                if (overrideAdv.has_value()) {
+                    bytes = overrideAdv.value();
+                }
+#endif
+
+                if (!Filter(companyId, bytes)) {
+                    return;
+                }
+
+                if (!receivedData.has_value()) {
+                    receivedData.emplace();
+                    receivedData->rssi = report.rssi;
+                    receivedData->timestamp = timestamp;
+                    receivedData->address = report.address;
+                }
+
+                receivedData->manufacturerDataMap.try_emplace(
+                    companyId, bytes.begin(), bytes.end());
+            });
+
+        if (!receivedData.has_value()) {
+            continue;
+        }
+
+        CbReceived().Invoke(receivedData.value());
+    }
+}
+} // namespace Core::Bluetooth
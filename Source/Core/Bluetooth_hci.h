@@ -0,0 +1,134 @@
+//
+// AirPodsDesktop - AirPods Desktop User Experience Enhancement Program.
+// Copyright (C) 2021-2022 SpriteOvO
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#if !defined APD_OS_LINUX || !defined APD_BLUETOOTH_HCI
+    #error "This file shouldn't be compiled."
+#endif
+
+#include <span>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <optional>
+#include <unordered_set>
+
+#include "Bluetooth_abstract.h"
+
+// Advertisements read from a raw HCI socket, instead of the `PropertiesChanged` signals of
+// bluetoothd. Devices are still from BlueZ, see "Bluetooth_linux.h".
+//
+namespace Core::Bluetooth {
+
+namespace Details::Hci {
+
+constexpr int8_t kRssiUnavailable = 127;
+
+// Long extended advertisements are reported in fragments. All but the last one are `Incomplete`,
+// and the last one is `Complete`, or `Truncated` if the controller dropped the rest.
+//
+enum class DataStatus : uint8_t {
+    Complete,
+    Incomplete,
+    Truncated,
+};
+
+struct AdvertisingReport {
+    uint64_t address{0};
+    int8_t rssi{0}; // `kRssiUnavailable` if unavailable
+    DataStatus status{DataStatus::Complete};
+    std::span<const uint8_t> data; // AD structures, refers to the event packet
+};
+
+// Parses an HCI event packet, starting with the packet type as read from a raw HCI socket.
+// LE Advertising Reports and LE Extended Advertising Reports are appended to `reports`, which is
+// cleared first. Returns false if the packet isn't an advertising report or is malformed.
+//
+bool ParseEvent(std::span<const uint8_t> packet, std::vector<AdvertisingReport> &reports);
+
+// Invokes `callback(companyId, data)` for each Manufacturer Specific Data AD structure, the company
+// identifier is not included in `data`
+//
+template <class Fn>
+inline void ForEachManufacturerData(std::span<const uint8_t> data, Fn &&callback)
+{
+    constexpr uint8_t kManufacturerSpecificData = 0xFF;
+
+    while (!data.empty()) {
+        const size_t length = data[0];
+        if (length == 0 || length >= data.size()) {
+            break;
+        }
+
+        const auto structure = data.subspan(1, length);
+        if (structure[0] == kManufacturerSpecificData && structure.size() >= 3) {
+            callback(
+                static_cast<uint16_t>(structure[1] | structure[2] << 8), structure.subspan(3));
+        }
+        data = data.subspan(1 + length);
+    }
+}
+} // namespace Details::Hci
+
+class AdvertisementWatcher final
+    : public Details::AdvertisementWatcherAbstract<AdvertisementWatcher>
+{
+public:
+    using Timestamp = std::chrono::system_clock::time_point;
+
+    // Scans with the first available HCI device, which requires `CAP_NET_RAW`
+    //
+    AdvertisementWatcher();
+
+    // Reads the events from the socket instead, e.g. one end of a `SOCK_SEQPACKET` socketpair fed
+    // with recorded HCI events. No controller is touched, and the socket isn't closed.
+    //
+    explicit AdvertisementWatcher(int socket);
+
+    ~AdvertisementWatcher();
+
+    bool Start() override;
+    bool Stop() override;
+
+private:
+    constexpr static std::chrono::milliseconds kPollInterval{200};
+    constexpr static size_t kMaxFragmented = 64;
+
+    std::atomic<bool> _stop{true};
+    std::thread _thread;
+    const bool _ownsSocket;
+    int _socket{-1};
+    bool _scanEnabled{false};
+
+    // Reused by the reading thread, so that parsing doesn't allocate
+    //
+    std::vector<Details::Hci::AdvertisingReport> _reports;
+
+    // Addresses in the middle of a fragmented advertisement, only used by the reading thread
+    //
+    std::unordered_set<uint64_t> _fragmented;
+
+    std::optional<std::string> OpenDevice();
+    void CloseDevice();
+
+    void Thread();
+    void OnEvent(std::span<const uint8_t> packet);
+};
+} // namespace Core::Bluetooth
@@ -18,12 +18,159 @@
 
 #include "Bluetooth_linux.h"
 
+#include <cstdio>
+#include <algorithm>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+
 // #include "../Logger.h"
 #include "Debug.h"
 #include "OS/linux.h"
 
 namespace Core::Bluetooth {
 
+//////////////////////////////////////////////////
+// SystemBus
+//
+
+namespace Details {
+
+// The only system bus connection of the module. Connecting costs the authentication and several
+// round trips, so it's created once and shared by all proxies, method calls and signal
+// subscriptions. Its event loop thread dispatches the signals.
+//
+class SystemBus final : public Helper::Singleton<SystemBus>
+{
+protected:
+    SystemBus() : _connection{sdbus::createSystemBusConnection()}
+    {
+        _connection->enterEventLoopAsync();
+    }
+    friend Helper::Singleton<SystemBus>;
+
+public:
+    constexpr static auto kBluezService = "org.bluez";
+
+    ~SystemBus()
+    {
+        _connection->leaveEventLoop();
+    }
+
+    std::unique_ptr<sdbus::IProxy> CreateBluezProxy(const std::string &objectPath)
+    {
+        return sdbus::createProxy(*_connection, kBluezService, objectPath);
+    }
+
+    // Proxies are bound to one object path, signals of any object are subscribed by a match rule
+    //
+    [[nodiscard]] sdbus::Slot AddMatch(const std::string &rule, sdbus::message_handler handler)
+    {
+        return _connection->addMatch(rule, std::move(handler));
+    }
+
+private:
+    std::unique_ptr<sdbus::IConnection> _connection;
+};
+} // namespace Details
+
+namespace {
+
+constexpr auto kAdapterInterface = "org.bluez.Adapter1";
+constexpr auto kDeviceInterface = "org.bluez.Device1";
+constexpr auto kObjectManagerInterface = "org.freedesktop.DBus.ObjectManager";
+constexpr auto kPropertiesInterface = "org.freedesktop.DBus.Properties";
+
+template <class T>
+T GetProperty(const Properties &properties, const std::string &name, T defaultValue)
+{
+    const auto iter = properties.find(name);
+    if (iter == properties.end()) {
+        return defaultValue;
+    }
+
+    try {
+        return iter->second.get<T>();
+    }
+    catch (const sdbus::Error &error) {
+        // LOG(Warn, "Property '{}' has an unexpected type. {}", name, error.what());
+        return defaultValue;
+    }
+}
+
+// "AA:BB:CC:DD:EE:FF" to 0xAABBCCDDEEFF, the same as the addresses in advertisements
+//
+std::optional<uint64_t> ParseAddress(std::string_view address, char separator = ':')
+{
+    if (address.size() != 17) {
+        return std::nullopt;
+    }
+
+    uint64_t result = 0;
+    for (size_t i = 0; i < address.size(); ++i) {
+        const char ch = address[i];
+        if (i % 3 == 2) {
+            if (ch != separator) {
+                return std::nullopt;
+            }
+            continue;
+        }
+
+        uint64_t digit;
+        if (ch >= '0' && ch <= '9') {
+            digit = ch - '0';
+        }
+        else if (ch >= 'A' && ch <= 'F') {
+            digit = ch - 'A' + 10;
+        }
+        else if (ch >= 'a' && ch <= 'f') {
+            digit = ch - 'a' + 10;
+        }
+        else {
+            return std::nullopt;
+        }
+        result = result << 4 | digit;
+    }
+    return result;
+}
+
+#if !defined APD_BLUETOOTH_HCI
+// "/org/bluez/hci0/dev_AA_BB_CC_DD_EE_FF" to 0xAABBCCDDEEFF, saves a lookup of the "Address"
+// property, which isn't in the changed properties
+//
+std::optional<uint64_t> ParseDevicePath(std::string_view path)
+{
+    constexpr std::string_view kPrefix = "/dev_";
+
+    const auto pos = path.rfind(kPrefix);
+    if (pos == std::string_view::npos) {
+        return std::nullopt;
+    }
+    return ParseAddress(path.substr(pos + kPrefix.size()), '_');
+}
+#endif
+
+// The properties a `Device` is built from. The others are neither cached nor rebuild the device,
+// e.g. "RSSI" and "ManufacturerData", which change with every advertisement during discovery.
+//
+bool IsDeviceProperty(std::string_view name)
+{
+    return name == "Address" || name == "Name" || name == "Modalias" || name == "Paired" ||
+           name == "Connected";
+}
+
+// BlueZ exposes the Device ID record as a modalias, e.g. "bluetooth:v004Cp200Ed0100"
+//
+std::optional<std::pair<uint16_t, uint16_t>> ParseModalias(const std::string &modalias)
+{
+    unsigned int vendorId, productId;
+    if (std::sscanf(modalias.c_str(), "%*[^:]:v%4Xp%4X", &vendorId, &productId) != 2) {
+        return std::nullopt;
+    }
+    return std::make_pair(static_cast<uint16_t>(vendorId), static_cast<uint16_t>(productId));
+}
+} // namespace
+
 //////////////////////////////////////////////////
 // Device
 //
@@ -33,6 +180,11 @@ Device::Device(const std::string &path) : _path(path)
     FetchProperties();
 }
 
+Device::Device(const std::string &path, const Properties &properties) : _path(path)
+{
+    LoadProperties(properties);
+}
+
 Device::Device(const Device &rhs)
 {
     CopyFrom(rhs);
@@ -45,7 +197,7 @@ Device::Device(Device &&rhs) noexcept
 
 Device::~Device()
 {
-    // Clean up resources if any
+    UnregisterHandlers();
 }
 
 Device &Device::operator=(const Device &rhs)
@@ -60,7 +212,7 @@ Device &Device::operator=(Device &&rhs) noexcept
     return *this;
 }
 
-std::string Device::GetAddress() const
+uint64_t Device::GetAddress() const
 {
     return _address;
 }
@@ -85,41 +237,77 @@ DeviceState Device::GetConnectionState() const
     return _connectionState;
 }
 
+bool Device::IsPaired() const
+{
+    return _paired;
+}
+
 void Device::CopyFrom(const Device &rhs)
 {
+    const bool linked = rhs._link != nullptr;
+
+    UnregisterHandlers();
+
     _path = rhs._path;
     _address = rhs._address;
     _name = rhs._name;
     _vendorId = rhs._vendorId;
     _productId = rhs._productId;
-    _connectionState = rhs._connectionState;
+    _paired = rhs._paired;
+    _connectionState = rhs._connectionState.load();
+
+    if (linked) {
+        RegisterHandlers();
+    }
 }
 
 void Device::MoveFrom(Device &&rhs) noexcept
 {
+    UnregisterHandlers();
+
     _path = std::move(rhs._path);
     _address = std::move(rhs._address);
     _name = std::move(rhs._name);
     _vendorId = rhs._vendorId;
     _productId = rhs._productId;
-    _connectionState = rhs._connectionState;
+    _paired = rhs._paired;
+    _connectionState = rhs._connectionState.load();
+
+    // The link is taken over, so no change is missed in between
+    //
+    if (rhs._link != nullptr) {
+        std::lock_guard<std::mutex> lock{rhs._link->mutex};
+        rhs._link->device = this;
+    }
+    _link = std::move(rhs._link);
 }
 
 void Device::FetchProperties()
 {
-    // Using sdbus-c++ to interact with the BlueZ D-Bus API to fetch properties
-    auto connection = sdbus::createSystemBusConnection();
-    auto proxy = sdbus::createProxy(*connection, "org.bluez", _path);
-    proxy->callMethod("GetAll").onInterface("org.freedesktop.DBus.Properties")
-        .withArguments("org.bluez.Device1")
-        .storeResultsTo(_properties);
+    Properties properties;
+
+    auto proxy = Details::SystemBus::GetInstance().CreateBluezProxy(_path);
+    proxy->callMethod("GetAll")
+        .onInterface(kPropertiesInterface)
+        .withArguments(kDeviceInterface)
+        .storeResultsTo(properties);
 
-    _address = _properties["Address"].get();
-    _name = _properties["Name"].get();
-    _vendorId = _properties["VendorID"].get();
-    _productId = _properties["ProductID"].get();
-    auto connected = _properties["Connected"].get();
-    _connectionState = connected ? DeviceState::Connected : DeviceState::Disconnected;
+    LoadProperties(properties);
+}
+
+void Device::LoadProperties(const Properties &properties)
+{
+    _address = ParseAddress(GetProperty<std::string>(properties, "Address", {})).value_or(0);
+    _name = GetProperty<std::string>(properties, "Name", {});
+
+    const auto ids = ParseModalias(GetProperty<std::string>(properties, "Modalias", {}));
+    _vendorId = ids.has_value() ? ids->first : 0;
+    _productId = ids.has_value() ? ids->second : 0;
+
+    _paired = GetProperty<bool>(properties, "Paired", false);
+    _connectionState = GetProperty<bool>(properties, "Connected", false)
+                           ? DeviceState::Connected
+                           : DeviceState::Disconnected;
 }
 
 //////////////////////////////////////////////////
@@ -127,53 +315,372 @@ void Device::FetchProperties()
 //
 
 namespace Details {
+// BlueZ devices cached in memory, so lookups and enumerations don't touch the bus. The cache is
+// seeded once by `GetManagedObjects` and kept current by `InterfacesAdded`, `InterfacesRemoved`
+// and `PropertiesChanged`.
+//
 class DeviceManager final : public Helper::Singleton<DeviceManager>,
                             Details::DeviceManagerAbstract<Device>
 {
 protected:
-    DeviceManager() = default;
+    DeviceManager()
+    {
+        auto &bus = SystemBus::GetInstance();
+
+        // Subscribe before seeding, so that no change in between is missed. The signals received
+        // until the cache is seeded are queued and applied over the seed in order, as they may be
+        // newer than the reply of `GetManagedObjects`.
+        //
+        _objectManager = bus.CreateBluezProxy("/");
+        _objectManager->uponSignal("InterfacesAdded")
+            .onInterface(kObjectManagerInterface)
+            .call([this](
+                      const sdbus::ObjectPath &path,
+                      const std::map<std::string, Properties> &interfaces) {
+                Dispatch([this, path, interfaces] { OnInterfacesAdded(path, interfaces); });
+            });
+        _objectManager->uponSignal("InterfacesRemoved")
+            .onInterface(kObjectManagerInterface)
+            .call([this](
+                      const sdbus::ObjectPath &path, const std::vector<std::string> &interfaces) {
+                Dispatch([this, path, interfaces] { OnInterfacesRemoved(path, interfaces); });
+            });
+        _objectManager->finishRegistration();
+
+        _propertiesChangedSlot = bus.AddMatch(
+            "type='signal',sender='org.bluez',interface='org.freedesktop.DBus.Properties',"
+            "member='PropertiesChanged',arg0='org.bluez.Device1'",
+            [this](sdbus::Message &message) { OnPropertiesChanged(message); });
+
+        try {
+            std::map<sdbus::ObjectPath, std::map<std::string, Properties>> objects;
+            _objectManager->callMethod("GetManagedObjects")
+                .onInterface(kObjectManagerInterface)
+                .storeResultsTo(objects);
+
+            for (const auto &[path, interfaces] : objects) {
+                OnInterfacesAdded(path, interfaces);
+            }
+        }
+        catch (const sdbus::Error &error) {
+            // LOG(Warn, "GetManagedObjects failed. {}", error.what());
+        }
+
+        // Signals keep being queued while the queue is drained, so they are applied in order
+        //
+        while (true) {
+            std::vector<std::function<void()>> pending;
+            {
+                std::lock_guard<std::mutex> lock{_pendingMutex};
+                if (_pending.empty()) {
+                    _seeded = true;
+                    break;
+                }
+                pending.swap(_pending);
+            }
+            for (const auto &handler : pending) {
+                handler();
+            }
+        }
+    }
     friend Helper::Singleton<DeviceManager>;
 
 public:
     std::vector<Device> GetDevicesByState(DeviceState state) const override
     {
+        std::lock_guard<std::mutex> lock{_mutex};
+
         std::vector<Device> result;
-        auto connection = sdbus::createSystemBusConnection();
-        auto proxy = sdbus::createProxy(*connection, "org.bluez", "/");
-        sdbus::MethodCall method = proxy->createMethodCall("org.bluez.Adapter1", "GetManagedObjects");
-        sdbus::Variant managedObjects;
-        proxy->callMethod(method).storeResultsTo(managedObjects);
-
-        auto objects = managedObjects.get<std::map<sdbus::ObjectPath, std::map<std::string, sdbus::Variant>>>();
-        for (const auto &object : objects)
+        for (const auto &[address, device] : _devices) {
+            if (IsInState(device, state)) {
+                result.push_back(Linked(device));
+            }
+        }
+        return result;
+    }
+
+    std::optional<Device> FindDevice(uint64_t address) const override
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+
+        const auto iter = _devices.find(address);
+        if (iter == _devices.end() || !iter->second.IsPaired()) {
+            return std::nullopt;
+        }
+        return Linked(iter->second);
+    }
+
+    void AddLink(uint64_t address, const std::shared_ptr<Device::Link> &link)
+    {
+        std::lock_guard<std::mutex> lock{_linksMutex};
+
+        const auto [begin, end] = _links.equal_range(address);
+        for (auto iter = begin; iter != end;) {
+            iter = iter->second.expired() ? _links.erase(iter) : std::next(iter);
+        }
+        _links.emplace(address, link);
+    }
+
+private:
+    struct Object {
+        Properties properties;
+        uint64_t address{0};
+    };
+
+    struct ConnectionChange {
+        uint64_t address{0};
+        DeviceState state{DeviceState::Disconnected};
+    };
+
+    mutable std::mutex _mutex;
+    std::unordered_map<std::string, Object> _objects; // By object path
+    std::unordered_map<uint64_t, Device> _devices;    // By address
+
+    // Devices handed out are linked by address. Not guarded by `_mutex`, as devices are copied
+    // with it held.
+    //
+    std::mutex _linksMutex;
+    std::unordered_multimap<uint64_t, std::weak_ptr<Device::Link>> _links;
+
+    // Signals received before the cache is seeded
+    //
+    std::mutex _pendingMutex;
+    bool _seeded{false};
+    std::vector<std::function<void()>> _pending;
+
+    std::unique_ptr<sdbus::IProxy> _objectManager;
+    sdbus::Slot _propertiesChangedSlot;
+
+    static bool IsInState(const Device &device, DeviceState state)
+    {
+        switch (state) {
+        case DeviceState::Paired:
+            return device.IsPaired();
+        case DeviceState::Disconnected:
+        case DeviceState::Connected:
+            return device.GetConnectionState() == state;
+        }
+        return false;
+    }
+
+    // Runs the handler of a signal, or queues it if the cache isn't seeded yet
+    //
+    template <class Handler>
+    void Dispatch(Handler &&handler)
+    {
         {
-            if (object.second.count("org.bluez.Device1"))
-            {
-                Device device(object.first);
-                if ((state == DeviceState::Connected && device.GetConnectionState() == DeviceState::Connected) ||
-                    (state == DeviceState::Disconnected && device.GetConnectionState() == DeviceState::Disconnected))
-                {
-                    result.push_back(std::move(device));
-                }
+            std::lock_guard<std::mutex> lock{_pendingMutex};
+            if (!_seeded) {
+                _pending.emplace_back(std::forward<Handler>(handler));
+                return;
             }
         }
+        handler();
+    }
 
+    // Called with `_mutex` locked, so a change after the copy is always delivered to it
+    //
+    static Device Linked(const Device &device)
+    {
+        Device result{device};
+        result.RegisterHandlers();
         return result;
     }
 
-    std::optional<Device> FindDevice(const std::string &address) const override
+    void OnInterfacesAdded(
+        const std::string &path, const std::map<std::string, Properties> &interfaces)
     {
-        auto devices = GetDevicesByState(DeviceState::Connected);
-        for (const auto &device : devices) {
-            if (device.GetAddress() == address) {
-                return device;
+        const auto iter = interfaces.find(kDeviceInterface);
+        if (iter == interfaces.end()) {
+            return;
+        }
+
+        Properties properties;
+        for (const auto &[name, value] : iter->second) {
+            if (IsDeviceProperty(name)) {
+                properties.emplace(name, value);
+            }
+        }
+
+        std::optional<ConnectionChange> change;
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            _objects[path].properties = std::move(properties);
+            change = Rebuild(path);
+        }
+        if (change.has_value()) {
+            OnConnectionChanged(change.value());
+        }
+    }
+
+    void OnInterfacesRemoved(const std::string &path, const std::vector<std::string> &interfaces)
+    {
+        if (std::find(interfaces.begin(), interfaces.end(), kDeviceInterface) == interfaces.end()) {
+            return;
+        }
+
+        std::optional<ConnectionChange> change;
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+
+            const auto iter = _objects.find(path);
+            if (iter == _objects.end()) {
+                return;
+            }
+
+            const auto address = iter->second.address;
+            if (const auto device = _devices.find(address); device != _devices.end()) {
+                if (device->second.GetConnectionState() == DeviceState::Connected) {
+                    change =
+                        ConnectionChange{.address = address, .state = DeviceState::Disconnected};
+                }
+                _devices.erase(device);
+            }
+            _objects.erase(iter);
+        }
+        if (change.has_value()) {
+            OnConnectionChanged(change.value());
+        }
+    }
+
+    void OnPropertiesChanged(sdbus::Message &message)
+    {
+        std::string interface;
+        Properties changed;
+        std::vector<std::string> invalidated;
+        message >> interface >> changed >> invalidated;
+
+        if (interface != kDeviceInterface) {
+            return;
+        }
+
+        // Most of the signals are advertisements during discovery, which don't change the device
+        //
+        const auto isDeviceProperty = [](const auto &property) {
+            return IsDeviceProperty(property.first);
+        };
+        if (std::none_of(changed.begin(), changed.end(), isDeviceProperty) &&
+            std::none_of(invalidated.begin(), invalidated.end(), IsDeviceProperty))
+        {
+            return;
+        }
+
+        Dispatch([this, path = std::string{message.getPath()}, changed = std::move(changed),
+                  invalidated = std::move(invalidated)]() mutable {
+            ApplyProperties(path, std::move(changed), invalidated);
+        });
+    }
+
+    void ApplyProperties(
+        const std::string &path, Properties changed, const std::vector<std::string> &invalidated)
+    {
+        std::optional<ConnectionChange> change;
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+
+            const auto iter = _objects.find(path);
+            if (iter == _objects.end()) {
+                return;
+            }
+
+            auto &properties = iter->second.properties;
+            for (auto &[name, value] : changed) {
+                if (IsDeviceProperty(name)) {
+                    properties[name] = std::move(value);
+                }
+            }
+            for (const auto &name : invalidated) {
+                properties.erase(name);
+            }
+            change = Rebuild(path);
+        }
+        if (change.has_value()) {
+            OnConnectionChanged(change.value());
+        }
+    }
+
+    // Called with `_mutex` locked. Returns the change if the device is connected or disconnected.
+    //
+    std::optional<ConnectionChange> Rebuild(const std::string &path)
+    {
+        auto &object = _objects.at(path);
+
+        Device device{path, object.properties};
+        const auto newState = device.GetConnectionState();
+
+        const auto iter = _devices.find(object.address);
+        const auto oldState =
+            iter != _devices.end() ? iter->second.GetConnectionState() : DeviceState::Disconnected;
+
+        if (object.address != device.GetAddress()) {
+            _devices.erase(object.address);
+            object.address = device.GetAddress();
+        }
+        _devices.insert_or_assign(object.address, std::move(device));
+
+        if (newState == oldState) {
+            return std::nullopt;
+        }
+        return ConnectionChange{.address = object.address, .state = newState};
+    }
+
+    // Called without `_mutex` locked. The callbacks are invoked without any lock held, as they
+    // may take the lock of the device owner, which copies and destroys devices with it held.
+    //
+    void OnConnectionChanged(const ConnectionChange &change)
+    {
+        std::vector<std::shared_ptr<Device::Link>> links;
+        {
+            std::lock_guard<std::mutex> lock{_linksMutex};
+
+            const auto [begin, end] = _links.equal_range(change.address);
+            for (auto iter = begin; iter != end; ++iter) {
+                if (auto link = iter->second.lock()) {
+                    links.push_back(std::move(link));
+                }
+            }
+        }
+
+        for (const auto &link : links) {
+            std::shared_ptr<const Helper::Callback<Device::FnConnectionStatusChanged>::CallbackList>
+                callbacks;
+            {
+                std::lock_guard<std::mutex> lock{link->mutex};
+                if (link->device == nullptr) {
+                    continue;
+                }
+                link->device->_connectionState = change.state;
+                callbacks = link->device->CbConnectionStatusChanged().GetSnapshot();
+            }
+
+            for (const auto &[handle, callback] : *callbacks) {
+                callback(change.state);
             }
         }
-        return std::nullopt;
     }
 };
 } // namespace Details
 
+void Device::RegisterHandlers()
+{
+    _link = std::make_shared<Link>();
+    _link->device = this;
+    Details::DeviceManager::GetInstance().AddLink(_address, _link);
+}
+
+void Device::UnregisterHandlers()
+{
+    if (_link == nullptr) {
+        return;
+    }
+
+    // Waits for the cache to finish with the device, its callbacks are invoked after unlocking
+    //
+    const auto link = std::move(_link);
+    std::lock_guard<std::mutex> lock{link->mutex};
+    link->device = nullptr;
+}
+
 namespace DeviceManager {
 
 std::vector<Device> GetDevicesByState(DeviceState state)
@@ -181,93 +688,335 @@ std::vector<Device> GetDevicesByState(DeviceState state)
     return Details::DeviceManager::GetInstance().GetDevicesByState(state);
 }
 
-std::optional<Device> FindDevice(const std::string &address)
+std::optional<Device> FindDevice(uint64_t address)
 {
     return Details::DeviceManager::GetInstance().FindDevice(address);
 }
 } // namespace DeviceManager
 
+#if !defined APD_BLUETOOTH_HCI
 //////////////////////////////////////////////////
 // AdvertisementWatcher
 //
 
 AdvertisementWatcher::AdvertisementWatcher()
 {
-    _connection = sdbus::createSystemBusConnection();
-    _object = sdbus::createObject(*_connection, "/org/bluez");
+    auto &bus = Details::SystemBus::GetInstance();
+
+    // Devices with rotated addresses appear as new objects, and adapters may be plugged later
+    //
+    _objectManager = bus.CreateBluezProxy("/");
+    _objectManager->uponSignal("InterfacesAdded")
+        .onInterface(kObjectManagerInterface)
+        .call([this](
+                  const sdbus::ObjectPath &path,
+                  const std::map<std::string, Properties> &interfaces) {
+            OnInterfacesAdded(path, interfaces);
+        });
+    _objectManager->uponSignal("InterfacesRemoved")
+        .onInterface(kObjectManagerInterface)
+        .call([this](const sdbus::ObjectPath &path, const std::vector<std::string> &interfaces) {
+            OnInterfacesRemoved(path, interfaces);
+        });
+    _objectManager->finishRegistration();
+
+    _deviceChangedSlot = bus.AddMatch(
+        "type='signal',sender='org.bluez',interface='org.freedesktop.DBus.Properties',"
+        "member='PropertiesChanged',arg0='org.bluez.Device1'",
+        [this](sdbus::Message &message) { OnDeviceChanged(message); });
+    _adapterChangedSlot = bus.AddMatch(
+        "type='signal',sender='org.bluez',interface='org.freedesktop.DBus.Properties',"
+        "member='PropertiesChanged',arg0='org.bluez.Adapter1'",
+        [this](sdbus::Message &message) { OnAdapterChanged(message); });
 }
 
 AdvertisementWatcher::~AdvertisementWatcher()
 {
-    if (!_stop) {
-        _destroy = true;
-        Stop();
-        std::unique_lock<std::mutex> lock{_conVarMutex};
-        _destroyConVar.wait_for(lock, 1s);
-    }
+    Stop();
+
+    // Unsubscribe before the members used by the handlers are destroyed
+    //
+    _adapterChangedSlot.reset();
+    _deviceChangedSlot.reset();
+    _objectManager.reset();
 }
 
 bool AdvertisementWatcher::Start()
 {
-    try {
-        _stop = false;
-        _lastStartTime = std::chrono::steady_clock::now();
-
-        _object->registerSignal("org.freedesktop.DBus.ObjectManager", "InterfacesAdded",
-            [this](sdbus::Signal &signal) { this->OnReceived(signal); });
-        _object->registerSignal("org.freedesktop.DBus.ObjectManager", "InterfacesRemoved",
-            [this](sdbus::Signal &signal) { this->OnStopped(signal); });
-        
+    _stop = false;
+    return StartDiscovery();
+}
+
+bool AdvertisementWatcher::Stop()
+{
+    if (_stop.exchange(true)) {
         return true;
-    } catch (const std::exception &e) {
-        // Logger::LogError("Failed to start AdvertisementWatcher: ", e.what());
-        return false;
     }
+
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+
+        if (_discovering) {
+            try {
+                _adapter->callMethod("StopDiscovery").onInterface(kAdapterInterface);
+            }
+            catch (const sdbus::Error &error) {
+                // LOG(Warn, "StopDiscovery failed. {}", error.what());
+            }
+            _discovering = false;
+        }
+        _lastReceived.clear();
+    }
+
+    CbStateChanged().Invoke(State::Stopped, std::nullopt);
+    return true;
 }
 
-bool AdvertisementWatcher::Stop()
+// Instead of retrying periodically, discovery is started again when an adapter is added or
+// powered on, until `Stop()` is called
+//
+bool AdvertisementWatcher::StartDiscovery()
 {
-    try {
-        _stop = true;
-        _object->unregisterSignalHandler("org.freedesktop.DBus.ObjectManager", "InterfacesAdded");
-        _object->unregisterSignalHandler("org.freedesktop.DBus.ObjectManager", "InterfacesRemoved");
+    std::optional<std::string> optError;
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+
+        if (_stop) {
+            return false;
+        }
+        if (_discovering) {
+            return true;
+        }
 
-        std::unique_lock<std::mutex> lock{_conVarMutex};
-        _stopConVar.wait_for(lock, kRetryInterval);
+        try {
+            if (!_adapter) {
+                std::map<sdbus::ObjectPath, std::map<std::string, Properties>> objects;
+                _objectManager->callMethod("GetManagedObjects")
+                    .onInterface(kObjectManagerInterface)
+                    .storeResultsTo(objects);
+
+                const auto iter =
+                    std::find_if(objects.begin(), objects.end(), [](const auto &object) {
+                        return object.second.contains(kAdapterInterface);
+                    });
+                if (iter != objects.end()) {
+                    _adapterPath = iter->first;
+                    _adapter = Details::SystemBus::GetInstance().CreateBluezProxy(_adapterPath);
+                }
+            }
 
-        return true;
-    } catch (const std::exception &e) {
-        // Logger::LogError("Failed to stop AdvertisementWatcher: ", e.what());
+            if (_adapter) {
+                // Without "DuplicateData", a device is reported only when its data changes, but
+                // every advertisement matters for the RSSI
+                //
+                const Properties filter{
+                    {"Transport", sdbus::Variant{std::string{"le"}}},
+                    {"DuplicateData", sdbus::Variant{true}}};
+
+                _adapter->callMethod("SetDiscoveryFilter")
+                    .onInterface(kAdapterInterface)
+                    .withArguments(filter);
+                _adapter->callMethod("StartDiscovery").onInterface(kAdapterInterface);
+                _discovering = true;
+            }
+            else {
+                optError = "No Bluetooth adapter found.";
+            }
+        }
+        catch (const sdbus::Error &error) {
+            optError = error.what();
+        }
+    }
+
+    if (optError.has_value()) {
+        CbStateChanged().Invoke(State::Stopped, optError);
         return false;
     }
+
+    CbStateChanged().Invoke(State::Started, std::nullopt);
+    return true;
 }
 
-void AdvertisementWatcher::OnReceived(const sdbus::Signal &signal)
+void AdvertisementWatcher::OnStopped(const std::optional<std::string> &optError)
 {
-    // Process the signal and notify the callback
-    std::string path;
-    signal >> path;
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
 
-    // Assuming signal contains device information
-    if (_stop) return;
+        if (!_discovering) {
+            return;
+        }
+        _discovering = false;
+        _lastReceived.clear();
+    }
 
-    // Notify the callback
-    if (_callback) {
-        _callback(path);
+    CbStateChanged().Invoke(State::Stopped, optError);
+}
+
+void AdvertisementWatcher::OnInterfacesAdded(
+    const std::string &path, const std::map<std::string, Properties> &interfaces)
+{
+    const auto iter = interfaces.find(kDeviceInterface);
+    if (iter != interfaces.end()) {
+        OnDeviceProperties(path, iter->second);
+    }
+    else if (interfaces.contains(kAdapterInterface)) {
+        StartDiscovery();
     }
 }
 
-void AdvertisementWatcher::OnStopped(const sdbus::Signal &signal)
+void AdvertisementWatcher::OnInterfacesRemoved(
+    const std::string &path, const std::vector<std::string> &interfaces)
 {
-    // Process the stop signal
-    if (_stop) {
-        std::unique_lock<std::mutex> lock{_conVarMutex};
-        _stopConVar.notify_all();
+    const auto contains = [&](const char *interface) {
+        return std::find(interfaces.begin(), interfaces.end(), interface) != interfaces.end();
+    };
+
+    if (contains(kDeviceInterface)) {
+        const auto address = ParseDevicePath(path);
+        if (address.has_value()) {
+            std::lock_guard<std::mutex> lock{_mutex};
+            _lastReceived.erase(address.value());
+        }
     }
-    if (_destroy) {
-        std::unique_lock<std::mutex> lock{_conVarMutex};
-        _destroyConVar.notify_all();
+    else if (contains(kAdapterInterface)) {
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+
+            if (!_adapter || path != _adapterPath) {
+                return;
+            }
+            _adapter.reset();
+            _adapterPath.clear();
+        }
+        OnStopped("The Bluetooth adapter is removed.");
+    }
+}
+
+void AdvertisementWatcher::OnDeviceChanged(sdbus::Message &message)
+{
+    std::string interface;
+    Properties changed;
+    std::vector<std::string> invalidated;
+    message >> interface >> changed >> invalidated;
+
+    if (interface == kDeviceInterface) {
+        OnDeviceProperties(message.getPath(), changed);
+    }
+}
+
+void AdvertisementWatcher::OnAdapterChanged(sdbus::Message &message)
+{
+    std::string interface;
+    Properties changed;
+    std::vector<std::string> invalidated;
+    message >> interface >> changed >> invalidated;
+
+    if (interface != kAdapterInterface || !changed.contains("Powered")) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        if (message.getPath() != _adapterPath) {
+            return;
+        }
     }
+
+    if (GetProperty<bool>(changed, "Powered", false)) {
+        StartDiscovery();
+    }
+    else {
+        OnStopped("The Bluetooth adapter is powered off.");
+    }
+}
+
+void AdvertisementWatcher::OnDeviceProperties(const std::string &path, const Properties &properties)
+{
+    const auto rssiIter = properties.find("RSSI");
+    const auto mfrDataIter = properties.find("ManufacturerData");
+    if (rssiIter == properties.end() && mfrDataIter == properties.end()) {
+        return;
+    }
+
+    const auto address = ParseDevicePath(path);
+    if (!address.has_value()) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock{_mutex};
+
+    if (!_discovering) {
+        return;
+    }
+
+    auto iter = _lastReceived.find(address.value());
+
+    if (mfrDataIter != properties.end()) {
+        std::map<uint16_t, std::vector<uint8_t>> manufacturerDataMap;
+        try {
+            const auto mfrData = mfrDataIter->second.get<std::map<uint16_t, sdbus::Variant>>();
+            for (const auto &[companyId, value] : mfrData) {
+                const auto data = value.get<std::vector<uint8_t>>();
+
+                std::span<const uint8_t> bytes{data};
+
+#if defined APD_DEBUG
+                auto overrideAdv = DebugConfig::GetInstance().GetOverrideAdv();
+                if (overrideAdv.has_value()) {
+                    bytes = overrideAdv.value();
+                }
+#endif
+
+                if (Filter(companyId, bytes)) {
+                    manufacturerDataMap.try_emplace(companyId, bytes.begin(), bytes.end());
+                }
+            }
+        }
+        catch (const sdbus::Error &error) {
+            // LOG(Warn, "ManufacturerData has an unexpected type. {}", error.what());
+            return;
+        }
+
+        // The device doesn't advertise anything we are interested in anymore
+        //
+        if (manufacturerDataMap.empty()) {
+            if (iter != _lastReceived.end()) {
+                _lastReceived.erase(iter);
+            }
+            return;
+        }
+
+        if (iter == _lastReceived.end()) {
+            iter = _lastReceived.try_emplace(address.value()).first;
+            iter->second.data.address = address.value();
+        }
+        iter->second.data.manufacturerDataMap = std::move(manufacturerDataMap);
+    }
+
+    if (iter == _lastReceived.end()) {
+        return;
+    }
+
+    auto &lastReceived = iter->second;
+    if (rssiIter != properties.end()) {
+        lastReceived.data.rssi = GetProperty<int16_t>(properties, "RSSI", lastReceived.data.rssi);
+        lastReceived.hasRssi = true;
+    }
+
+    // A device found by the data may not have reported its RSSI yet
+    //
+    if (!lastReceived.hasRssi) {
+        return;
+    }
+
+    // Invoked with a copy, so the consumers don't hold up the other signals and `Stop`
+    //
+    lastReceived.data.timestamp = std::chrono::system_clock::now();
+    const auto receivedData = lastReceived.data;
+    lock.unlock();
+
+    CbReceived().Invoke(receivedData);
 }
+#endif
 
 } // namespace Core::Bluetooth
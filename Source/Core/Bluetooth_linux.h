@@ -22,14 +22,15 @@
     #error "This file shouldn't be compiled."
 #endif
 
+#include <map>
 #include <string>
 #include <vector>
 #include <optional>
 #include <atomic>
 #include <mutex>
-#include <condition_variable>
-#include <thread>
+#include <unordered_map>
 #include <chrono>
+#include <memory>
 #include <dbus/dbus.h>
 #include <sdbus-c++/sdbus-c++.h>
 
@@ -37,10 +38,23 @@
 
 namespace Core::Bluetooth {
 
-class Device final : public Details::DeviceAbstract<std::string>
+using Properties = std::map<std::string, sdbus::Variant>;
+
+namespace Details {
+class DeviceManager;
+} // namespace Details
+
+class Device final : public Details::DeviceAbstract<uint64_t>
 {
 public:
+    // Fetches the properties of the object with a `GetAll` call
+    //
     Device(const std::string &path);
+
+    // From the `org.bluez.Device1` properties already fetched, e.g. by `GetManagedObjects`
+    //
+    Device(const std::string &path, const Properties &properties);
+
     Device(const Device &rhs);
     Device(Device &&rhs) noexcept;
     ~Device();
@@ -48,33 +62,50 @@ public:
     Device &operator=(const Device &rhs);
     Device &operator=(Device &&rhs) noexcept;
 
-    std::string GetAddress() const override;
+    uint64_t GetAddress() const override;
     std::string GetName() const override;
     uint16_t GetVendorId() const override;
     uint16_t GetProductId() const override;
     DeviceState GetConnectionState() const override;
 
+    bool IsPaired() const;
+
 private:
+    // Devices returned by `DeviceManager` and their copies are linked to the cache by address,
+    // which updates their connection state and invokes `CbConnectionStatusChanged`
+    //
+    struct Link {
+        std::mutex mutex;
+        Device *device{nullptr};
+    };
+    friend Details::DeviceManager;
+
     std::string _path;
-    std::string _address;
+    uint64_t _address{0};
     std::string _name;
-    uint16_t _vendorId;
-    uint16_t _productId;
-    DeviceState _connectionState;
-
+    uint16_t _vendorId{0};
+    uint16_t _productId{0};
+    bool _paired{false};
+    std::atomic<DeviceState> _connectionState{DeviceState::Disconnected};
+    std::shared_ptr<Link> _link;
+
+    void RegisterHandlers();
+    void UnregisterHandlers();
     void CopyFrom(const Device &rhs);
     void MoveFrom(Device &&rhs) noexcept;
 
     void FetchProperties();
+    void LoadProperties(const Properties &properties);
 };
 
 namespace DeviceManager {
 
 std::vector<Device> GetDevicesByState(DeviceState state);
-std::optional<Device> FindDevice(const std::string &address);
+std::optional<Device> FindDevice(uint64_t address);
 
 } // namespace DeviceManager
 
+#if !defined APD_BLUETOOTH_HCI
 class AdvertisementWatcher final
     : public Details::AdvertisementWatcherAbstract<AdvertisementWatcher>
 {
@@ -88,17 +119,36 @@ public:
     bool Stop() override;
 
 private:
-    static constexpr std::chrono::seconds kRetryInterval{3};
-    
-    std::atomic<bool> _stop{false}, _destroy{false};
-    std::atomic<std::chrono::steady_clock::time_point> _lastStartTime;
-    std::mutex _conVarMutex;
-    std::condition_variable _stopConVar, _destroyConVar;
-
-    std::unique_ptr<sdbus::IConnection> _connection;
-    std::unique_ptr<sdbus::IObject> _object;
-
-    void OnReceived(const sdbus::Signal &signal);
-    void OnStopped(const sdbus::Signal &signal);
+    // BlueZ delivers advertisements as changes of the device properties, which carry only the
+    // properties that changed. The last accepted advertisement of each address is kept to fill in
+    // the rest.
+    //
+    struct LastReceived {
+        ReceivedData data;
+        bool hasRssi{false};
+    };
+
+    std::mutex _mutex;
+    std::atomic<bool> _stop{true};
+    bool _discovering{false};
+    std::string _adapterPath;
+    std::unique_ptr<sdbus::IProxy> _adapter;
+    std::unordered_map<uint64_t, LastReceived> _lastReceived;
+
+    // Created on the connection shared by the module
+    //
+    std::unique_ptr<sdbus::IProxy> _objectManager;
+    sdbus::Slot _deviceChangedSlot, _adapterChangedSlot;
+
+    bool StartDiscovery();
+    void OnStopped(const std::optional<std::string> &optError);
+
+    void OnInterfacesAdded(
+        const std::string &path, const std::map<std::string, Properties> &interfaces);
+    void OnInterfacesRemoved(const std::string &path, const std::vector<std::string> &interfaces);
+    void OnDeviceChanged(sdbus::Message &message);
+    void OnAdapterChanged(sdbus::Message &message);
+    void OnDeviceProperties(const std::string &path, const Properties &properties);
 };
+#endif
 } // namespace Core::Bluetooth
@@ -329,11 +329,7 @@ bool AdvertisementWatcher::Stop()
 
 void AdvertisementWatcher::OnReceived(const BluetoothLEAdvertisementReceivedEventArgs &args)
 {
-    ReceivedData receivedData;
-
-    receivedData.rssi = args.RawSignalStrengthInDBm();
-    receivedData.timestamp = args.Timestamp();
-    receivedData.address = args.BluetoothAddress();
+    std::optional<ReceivedData> receivedData;
 
     const auto &manufacturerDataArray = args.Advertisement().ManufacturerData();
     for (uint32_t i = 0; i < manufacturerDataArray.Size(); ++i) {
@@ -341,21 +337,36 @@ void AdvertisementWatcher::OnReceived(const BluetoothLEAdvertisementReceivedEven
         const auto companyId = manufacturerData.CompanyId();
         const auto &data = manufacturerData.Data();
 
-        std::vector<uint8_t> stdData(data.data(), data.data() + data.Length());
+        std::span<const uint8_t> bytes{data.data(), data.Length()};
 
 #if defined APD_DEBUG
         auto overrideAdv = DebugConfig::GetInstance().GetOverrideAdv();
         if (overrideAdv.has_value()) {
-            stdData = std::move(overrideAdv.value());
-            LOG(Trace, "Adv override: {}", Helper::ToString(stdData));
+            bytes = overrideAdv.value();
+            LOG(Trace, "Adv override: {}", Helper::ToString(overrideAdv.value()));
         }
 #endif
 
-        receivedData.manufacturerDataMap.try_emplace(companyId, std::move(stdData));
+        if (!Filter(companyId, bytes)) {
+            continue;
+        }
+
+        if (!receivedData.has_value()) {
+            receivedData.emplace();
+            receivedData->rssi = args.RawSignalStrengthInDBm();
+            receivedData->timestamp = args.Timestamp();
+            receivedData->address = args.BluetoothAddress();
+        }
+
+        receivedData->manufacturerDataMap.try_emplace(companyId, bytes.begin(), bytes.end());
+    }
+
+    if (!receivedData.has_value()) {
+        return;
     }
 
     std::lock_guard<std::mutex> lock{_mutex};
-    CbReceived().Invoke(receivedData);
+    CbReceived().Invoke(receivedData.value());
 }
 
 void AdvertisementWatcher::OnStopped(const BluetoothLEAdvertisementWatcherStoppedEventArgs &args)
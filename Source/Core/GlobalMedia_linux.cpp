@@ -18,7 +18,7 @@
 
 #include "GlobalMedia_linux.h"
 
-#include "../Utils.h"
+#include "../Helper.h"
 // #include "../Logger.h"
 #include "../Error.h"
 #include <dbus/dbus.h>
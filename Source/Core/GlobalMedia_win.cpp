@@ -20,7 +20,7 @@
 
 #include <Functiondiscoverykeys_devpkey.h>
 
-#include "../Utils.h"
+#include "../Helper.h"
 #include "../Logger.h"
 
 namespace Core::GlobalMedia {
@@ -237,7 +237,7 @@ private:
             //     info.processName
             // );
 
-            if (Utils::Text::ToLower(info.processName) != Utils::Text::ToLower(processName)) {
+            if (Helper::Text::ToLower(info.processName) != Helper::Text::ToLower(processName)) {
                 // LOG(Trace, L"The media window process name mismatch.");
                 continue;
             }
@@ -112,6 +112,31 @@ void OnApply_rssi_min(const Fields &newFields)
     ApdApp->GetMainWindow()->GetApdMgr().OnRssiMinChanged(newFields.rssi_min);
 }
 
+namespace {
+// `device_address` is the primary one, the extra devices are only bound along with it
+//
+void ApplyBoundDevices(const Fields &newFields)
+{
+    std::vector<uint64_t> addresses;
+
+    if (newFields.device_address != 0) {
+        addresses.push_back(newFields.device_address);
+
+        for (const auto &strAddress : newFields.extra_device_addresses) {
+            bool isOk = false;
+            const auto address = strAddress.toULongLong(&isOk, 16);
+            if (!isOk) {
+                // LOG(Warn, "Invalid extra device address.");
+                continue;
+            }
+            addresses.push_back(address);
+        }
+    }
+
+    ApdApp->GetMainWindow()->GetApdMgr().OnBoundDevicesChanged(addresses);
+}
+} // namespace
+
 void OnApply_device_address(const Fields &newFields)
 {
     // LOG(Info, "OnApply_device_address: {}", LogSensitiveData(newFields.device_address));
@@ -123,7 +148,7 @@ void OnApply_device_address(const Fields &newFields)
         ApdApp->GetMainWindow()->BindSafely();
     }
 
-    ApdApp->GetMainWindow()->GetApdMgr().OnBoundDeviceAddressChanged(newFields.device_address);
+    ApplyBoundDevices(newFields);
 }
 
 void OnApply_tray_icon_battery(const Fields &newFields)
@@ -140,6 +165,22 @@ void OnApply_battery_on_taskbar(const Fields &newFields)
     // ApdApp->GetTaskbarStatus()->OnSettingsChangedSafely(newFields.battery_on_taskbar);
 }
 
+void OnApply_state_batch_window_ms(const Fields &newFields)
+{
+    // LOG(Info, "OnApply_state_batch_window_ms: {}", newFields.state_batch_window_ms);
+
+    ApdApp->GetMainWindow()->GetApdMgr().OnStateBatchWindowChanged(
+        std::chrono::milliseconds{newFields.state_batch_window_ms});
+}
+
+void OnApply_extra_device_addresses(const Fields &newFields)
+{
+    // LOG(Info, "OnApply_extra_device_addresses: {}",
+    //     LogSensitiveData(newFields.extra_device_addresses));
+
+    ApplyBoundDevices(newFields);
+}
+
 class Manager : public Helper::Singleton<Manager>
 {
 protected:
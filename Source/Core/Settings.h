@@ -21,6 +21,7 @@
 #include <mutex>
 
 #include <QSettings>
+#include <QStringList>
 
 #include "../Helper.h"
 
@@ -53,7 +54,13 @@ enum class LoadResult : uint32_t { AbiIncompatible, NoAbiField, Successful };
     callback(TrayIconBatteryBehavior, tray_icon_battery, {TrayIconBatteryBehavior::Disable},       \
         Impl::OnApply(&OnApply_tray_icon_battery))                                                 \
     callback(TaskbarStatusBehavior, battery_on_taskbar, {TaskbarStatusBehavior::Disable},          \
-        Impl::OnApply(&OnApply_battery_on_taskbar))
+        Impl::OnApply(&OnApply_battery_on_taskbar))                                                \
+    callback(uint32_t, state_batch_window_ms, {0},                                                 \
+        Impl::OnApply(&OnApply_state_batch_window_ms),                                             \
+        Impl::Desc{QObject::tr("Advertisements received within this window are applied at once. 0 to disable.")}) \
+    callback(QStringList, extra_device_addresses, {},                                              \
+        Impl::OnApply(&OnApply_extra_device_addresses),                                            \
+        Impl::Sensitive{})
 // clang-format on
 
 struct Fields {
@@ -215,6 +222,8 @@ void OnApply_rssi_min(const Fields &newFields);
 void OnApply_device_address(const Fields &newFields);
 void OnApply_tray_icon_battery(const Fields &newFields);
 void OnApply_battery_on_taskbar(const Fields &newFields);
+void OnApply_state_batch_window_ms(const Fields &newFields);
+void OnApply_extra_device_addresses(const Fields &newFields);
 
 struct MetaFields {
 #define DECLARE_META_FIELD(type, name, dft, ...)                                                   \
@@ -19,8 +19,8 @@
 #include "Error.h"
 
 #include <format>
-#include <cstdlib>
 #include <fstream>
+#include <iostream>
 
 #include <QMessageBox>
 #include <QDesktopServices>
@@ -44,21 +44,10 @@ void WriteStackTraceFile()
 
     file << stacktrace::stacktrace();
 }
-} // namespace Impl
-
-void Initialize()
-{
-    auto workspace = Utils::File::GetWorkspace();
-
-    // Delete the last StackTrace log file, if any
-    //
-    workspace.remove(kStackTraceFileName);
-}
-} // namespace Error
 
-[[noreturn]] void FatalError(const std::string &content, bool report)
+void ShowFatalError(const std::string &content, bool report)
 {
-    Error::Impl::WriteStackTraceFile();
+    WriteStackTraceFile();
 
 #if !defined APD_OS_WIN
     std::cerr << "AN error has occured, please check the log file for more information." << std::endl;
@@ -102,5 +91,17 @@ void Initialize()
 #endif
 
 #endif // APD_OS_WIN
-    std::abort();
 }
+} // namespace Impl
+
+void Initialize()
+{
+    auto workspace = Utils::File::GetWorkspace();
+
+    // Delete the last StackTrace log file, if any
+    //
+    workspace.remove(kStackTraceFileName);
+
+    SetFatalHandler(&Impl::ShowFatalError);
+}
+} // namespace Error
@@ -19,9 +19,19 @@
 #pragma once
 
 #include <string>
+#include <functional>
 
 namespace Error {
 
+using FnFatalHandler = std::function<void(const std::string &content, bool report)>;
+
+// `FatalError` reports to the handler and aborts after it returns, so that Core doesn't depend on
+// the GUI. Without a handler, the content is written to stderr.
+//
+void SetFatalHandler(FnFatalHandler handler);
+
+// Installs the handler of the application, which shows the error to the user
+//
 void Initialize();
 
 } // namespace Error
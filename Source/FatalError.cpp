@@ -0,0 +1,51 @@
+//
+// AirPodsDesktop - AirPods Desktop User Experience Enhancement Program.
+// Copyright (C) 2021-2022 SpriteOvO
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Error.h"
+
+#include <cstdlib>
+#include <iostream>
+
+namespace Error {
+namespace Impl {
+
+FnFatalHandler &GetFatalHandler()
+{
+    static FnFatalHandler handler;
+    return handler;
+}
+} // namespace Impl
+
+void SetFatalHandler(FnFatalHandler handler)
+{
+    Impl::GetFatalHandler() = std::move(handler);
+}
+} // namespace Error
+
+[[noreturn]] void FatalError(const std::string &content, bool report)
+{
+    const auto &handler = Error::Impl::GetFatalHandler();
+    if (handler) {
+        handler(content, report);
+    }
+    else {
+        std::cerr << "Fatal error: " << content << std::endl;
+    }
+
+    std::abort();
+}
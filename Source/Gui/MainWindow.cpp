@@ -149,6 +149,8 @@ private:
 MainWindow::MainWindow(QWidget *parent) : QDialog{parent}
 {
     qRegisterMetaType<Core::AirPods::State>("Core::AirPods::State");
+    qRegisterMetaType<Core::AirPods::StateFields>("Core::AirPods::StateFields");
+    qRegisterMetaType<Core::AirPods::DeviceKey>("Core::AirPods::DeviceKey");
 
     _videoWidget = new VideoWidget{this};
     _closeButton = new CloseButton{this};
@@ -174,12 +176,33 @@ MainWindow::MainWindow(QWidget *parent) : QDialog{parent}
     connect(this, &MainWindow::UpdateStateSafely, this, &MainWindow::UpdateState);
     connect(this, &MainWindow::AvailableSafely, this, &MainWindow::Available);
     connect(this, &MainWindow::UnavailableSafely, this, &MainWindow::Unavailable);
-    connect(this, &MainWindow::DisconnectSafely, this, &MainWindow::Disconnect);
+    connect(this, &MainWindow::DisconnectDeviceSafely, this, &MainWindow::DisconnectDevice);
     connect(this, &MainWindow::BindSafely, this, &MainWindow::Bind);
     connect(this, &MainWindow::UnbindSafely, this, &MainWindow::Unbind);
+    connect(this, &MainWindow::LidOpenedSafely, this, &MainWindow::OnLidOpened);
     connect(this, &MainWindow::ShowSafely, this, &MainWindow::show);
     connect(this, &MainWindow::HideSafely, this, &MainWindow::DoHide);
 
+    _apdMgr.CbStateChanged() += [this](
+                                    Core::AirPods::DeviceKey key, const Core::AirPods::State &state,
+                                    Core::AirPods::StateFields changedFields) {
+        UpdateStateSafely(key, state, changedFields);
+    };
+    _apdMgr.CbDisconnected() += [this](Core::AirPods::DeviceKey key) {
+        DisconnectDeviceSafely(key);
+    };
+    _apdMgr.CbAvailabilityChanged() += [this](bool available) {
+        if (available) {
+            AvailableSafely();
+        }
+        else {
+            UnavailableSafely();
+        }
+    };
+    _apdMgr.CbLidOpened() += [this](Core::AirPods::DeviceKey key, bool opened) {
+        LidOpenedSafely(key, opened);
+    };
+
     _posAnimation.setDuration(500);
     _autoHideTimer->callOnTimeout([this] { DoHide(); });
     _mediaPlayer->setMuted(true);
@@ -199,14 +222,48 @@ MainWindow::MainWindow(QWidget *parent) : QDialog{parent}
     _updateChecker.Start();
 }
 
-void MainWindow::UpdateState(const Core::AirPods::State &state)
+void MainWindow::UpdateState(
+    Core::AirPods::DeviceKey key, const Core::AirPods::State &state,
+    Core::AirPods::StateFields changedFields)
 {
     // LOG(Info, "MainWindow::UpdateState");
 
+    ApdApp->GetTrayIcon()->UpdateState(key, state, changedFields);
+
+    auto iter = std::find_if(_deviceStates.begin(), _deviceStates.end(), [&](const auto &pair) {
+        return pair.first == key;
+    });
+    if (iter == _deviceStates.end()) {
+        _deviceStates.emplace_back(key, state);
+    }
+    else {
+        iter->second = state;
+    }
+
+    // The window follows the device whose lid is just opened, since it's going to be shown for it
+    //
+    const bool isLidJustOpened =
+        (changedFields & Core::AirPods::StateField::Lid) != 0 && state.caseBox.isLidOpened;
+
+    const bool switchFocus = !_focusedDevice.has_value() || isLidJustOpened;
+    if (!switchFocus && key != _focusedDevice) {
+        return;
+    }
+
+    // Repaint everything if we are switched from another status or another device
+    //
+    const bool fullRepaint =
+        _status != Status::Updating || !_cachedState.has_value() || key != _focusedDevice;
+
+    _focusedDevice = key;
     _status = Status::Updating;
     _cachedState = state;
-    Repaint();
-    ApdApp->GetTrayIcon()->UpdateState(state);
+    if (fullRepaint) {
+        Repaint();
+    }
+    else {
+        RepaintState(changedFields);
+    }
 #if APD_HAS_TASKBAR_STATUS
     ApdApp->GetTaskbarStatus()->UpdateState(state);
 #endif
@@ -229,7 +286,9 @@ void MainWindow::Unavailable()
     // LOG(Info, "MainWindow::Unavailable");
 
     _status = Status::Unavailable;
+    _focusedDevice.reset();
     _cachedState.reset();
+    _deviceStates.clear();
     Repaint();
     ApdApp->GetTrayIcon()->Unavailable();
 #if APD_HAS_TASKBAR_STATUS
@@ -245,7 +304,9 @@ void MainWindow::Disconnect()
         return;
     }
     _status = Status::Disconnected;
+    _focusedDevice.reset();
     _cachedState.reset();
+    _deviceStates.clear();
     Repaint();
     ApdApp->GetTrayIcon()->Disconnect();
     #if APD_HAS_TASKBAR_STATUS
@@ -253,6 +314,42 @@ void MainWindow::Disconnect()
     #endif
 }
 
+void MainWindow::DisconnectDevice(Core::AirPods::DeviceKey key)
+{
+    // LOG(Info, "MainWindow::DisconnectDevice");
+
+    ApdApp->GetTrayIcon()->Disconnect(key);
+
+    std::erase_if(_deviceStates, [&](const auto &pair) { return pair.first == key; });
+
+    if (_status == Status::Unbind || key != _focusedDevice) {
+        return;
+    }
+
+    // Another bound device may still be tracked, its state won't be delivered again until it
+    // changes
+    //
+    if (!_deviceStates.empty()) {
+        const auto &[otherKey, otherState] = _deviceStates.front();
+
+        _focusedDevice = otherKey;
+        _cachedState = otherState;
+        Repaint();
+    #if APD_HAS_TASKBAR_STATUS
+        ApdApp->GetTaskbarStatus()->UpdateState(otherState);
+    #endif
+        return;
+    }
+
+    _status = Status::Disconnected;
+    _focusedDevice.reset();
+    _cachedState.reset();
+    Repaint();
+    #if APD_HAS_TASKBAR_STATUS
+    ApdApp->GetTaskbarStatus()->Disconnect();
+    #endif
+}
+
 void MainWindow::Bind()
 {
     // LOG(Info, "MainWindow::Bind");
@@ -266,7 +363,9 @@ void MainWindow::Unbind()
     // LOG(Info, "MainWindow::Unbind");
 
     _status = Status::Unbind;
+    _focusedDevice.reset();
     _cachedState.reset();
+    _deviceStates.clear();
     Repaint();
     ApdApp->GetTrayIcon()->Unbind();
 }
@@ -302,50 +401,10 @@ void MainWindow::SetAnimation(std::optional<Core::AirPods::Model> model)
         _mediaPlayer->setMedia(QMediaContent{});
     }
     else {
-        QString media;
-
-        // It's not possible to set video padding background color or get video resolution just
-        // through Qt, so we hardcode it here
-        QSize videoSize{};
-
-        switch (model.value()) {
-        case Core::AirPods::Model::AirPods_1:
-            media = "qrc:/Resource/Video/AirPods_1.avi";
-            videoSize = QSize{800, 400};
-            break;
-        case Core::AirPods::Model::AirPods_2:
-            media = "qrc:/Resource/Video/AirPods_2.avi";
-            videoSize = QSize{800, 400};
-            break;
-        case Core::AirPods::Model::AirPods_3:
-            media = "qrc:/Resource/Video/AirPods_3.avi";
-            videoSize = QSize{900, 450};
-            break;
-        case Core::AirPods::Model::AirPods_Pro:
-            media = "qrc:/Resource/Video/AirPods_Pro.avi";
-            videoSize = QSize{900, 450};
-            break;
-        case Core::AirPods::Model::AirPods_Pro_2:
-        case Core::AirPods::Model::AirPods_Pro_2_USB_C:
-            media = "qrc:/Resource/Video/AirPods_Pro_2.avi";
-            videoSize = QSize{900, 450};
-            break;
-        case Core::AirPods::Model::AirPods_Max:
-            media = "qrc:/Resource/Video/AirPods_Max.avi";
-            videoSize = QSize{600, 650};
-            break;
-        case Core::AirPods::Model::Beats_Fit_Pro:
-            media = "qrc:/Resource/Video/Beats_Fit_Pro.avi";
-            videoSize = QSize{900, 450};
-            break;
-        case Core::AirPods::Model::Powerbeats_3:
-        case Core::AirPods::Model::Beats_X:
-        case Core::AirPods::Model::Beats_Solo3:
-        default:
-            media = "qrc:/Resource/Video/AirPods_1.avi";
-            videoSize = QSize{800, 400};
-            break;
-        }
+        const auto &info = Core::AirPods::GetModelInfo(model.value());
+
+        QString media = info.media;
+        QSize videoSize{info.videoWidth, info.videoHeight};
 
         auto aspectRatio = (float)videoSize.width() / (float)videoSize.height();
         auto widgetWidth = _videoWidget->height() * aspectRatio;
@@ -376,17 +435,15 @@ void MainWindow::StopAnimation()
     _mediaPlayer->stop();
 }
 
-void MainWindow::BindDevice()
+std::optional<Core::Bluetooth::Device> MainWindow::SelectDevice()
 {
-    // LOG(Info, "BindDevice");
-
     const auto devices = Core::AirPods::GetDevices();
     if (devices.empty()) {
         QMessageBox::warning(
             this, Config::ProgramName,
             QMessageBox::tr("No paired device found.\n"
                             "You need to pair your AirPods in Windows Bluetooth Settings first."));
-        return;
+        return std::nullopt;
     }
 
     int selectedIndex = 0;
@@ -405,24 +462,59 @@ void MainWindow::BindDevice()
         SelectWindow selector{tr("Please select your AirPods device below."), deviceNames, this};
         if (selector.exec() == -1) {
             // LOG(Warn, "selector.exec() == -1");
-            return;
+            return std::nullopt;
         }
 
         if (!selector.HasResult()) {
             // LOG(Info, "No result for selector.");
-            return;
+            return std::nullopt;
         }
 
         selectedIndex = selector.GetSeletedIndex();
         APD_ASSERT(selectedIndex >= 0 && selectedIndex < devices.size());
     }
 
-    const auto &selectedDevice = devices.at(selectedIndex);
+    // LOG(Info, "Selected device index: '{}', device name: '{}'.", selectedIndex,
+    //     devices.at(selectedIndex).GetName());
 
-    // LOG(Info, "Selected device index: '{}', device name: '{}'. Bound to this device.",
-        selectedIndex, selectedDevice.GetName());
+    return devices.at(selectedIndex);
+}
 
-    Core::Settings::ModifiableAccess()->device_address = selectedDevice.GetAddress();
+void MainWindow::BindDevice()
+{
+    // LOG(Info, "BindDevice");
+
+    const auto optDevice = SelectDevice();
+    if (!optDevice.has_value()) {
+        return;
+    }
+
+    Core::Settings::ModifiableAccess()->device_address = optDevice->GetAddress();
+}
+
+// Binds one more device along with the current one, all of them are tracked at the same time
+//
+void MainWindow::BindAnotherDevice()
+{
+    // LOG(Info, "BindAnotherDevice");
+
+    const auto optDevice = SelectDevice();
+    if (!optDevice.has_value()) {
+        return;
+    }
+
+    const uint64_t address = optDevice->GetAddress();
+    const auto strAddress = QString::number(address, 16);
+
+    auto access = Core::Settings::ModifiableAccess();
+    if (access->device_address == 0) {
+        access->device_address = address;
+    }
+    else if (access->device_address != address &&
+             !access->extra_device_addresses.contains(strAddress, Qt::CaseInsensitive))
+    {
+        access->extra_device_addresses.append(strAddress);
+    }
 }
 
 void MainWindow::ControlAutoHideTimer(bool start)
@@ -475,38 +567,50 @@ void MainWindow::Repaint()
         return;
     }
 
-    const auto &state = _cachedState.value();
-
-    _ui.deviceLabel->setText(state.displayName);
+    RepaintState(Core::AirPods::StateField::All);
+}
 
-    SetAnimation(state.model);
+// Only updates the widgets affected by the given fields of `_cachedState`
+//
+void MainWindow::RepaintState(Core::AirPods::StateFields fields)
+{
+    using Core::AirPods::StateField;
 
-    if (!state.pods.left.battery.Available()) {
-        _leftBattery->hide();
-    }
-    else {
-        _leftBattery->setCharging(state.pods.left.isCharging);
-        _leftBattery->setValue(state.pods.left.battery.Value());
-        _leftBattery->show();
+    if (!_cachedState.has_value()) {
+        return;
     }
 
-    if (!state.pods.right.battery.Available()) {
-        _rightBattery->hide();
-    }
-    else {
-        _rightBattery->setCharging(state.pods.right.isCharging);
-        _rightBattery->setValue(state.pods.right.battery.Value());
-        _rightBattery->show();
-    }
+    const auto &state = _cachedState.value();
 
-    if (!state.caseBox.battery.Available()) {
-        _caseBattery->hide();
-    }
-    else {
-        _caseBattery->setCharging(state.caseBox.isCharging);
-        _caseBattery->setValue(state.caseBox.battery.Value());
-        _caseBattery->show();
+    const auto repaintBattery = [fields](
+                                    Widget::Battery *widget, const auto &basicState,
+                                    Core::AirPods::StateFields batteryField,
+                                    Core::AirPods::StateFields chargingField) {
+        if ((fields & (batteryField | chargingField)) == 0) {
+            return;
+        }
+
+        if (!basicState.battery.Available()) {
+            widget->hide();
+        }
+        else {
+            widget->setCharging(basicState.isCharging);
+            widget->setValue(basicState.battery.Value());
+            widget->show();
+        }
+    };
+
+    if (fields & StateField::Model) {
+        _ui.deviceLabel->setText(state.displayName);
+        SetAnimation(state.model);
     }
+
+    repaintBattery(
+        _leftBattery, state.pods.left, StateField::LeftBattery, StateField::LeftCharging);
+    repaintBattery(
+        _rightBattery, state.pods.right, StateField::RightBattery, StateField::RightCharging);
+    repaintBattery(
+        _caseBattery, state.caseBox, StateField::CaseBattery, StateField::CaseCharging);
 }
 
 void MainWindow::OnAppStateChanged(Qt::ApplicationState state)
@@ -562,6 +666,18 @@ void MainWindow::OnPlayerStateChanged(QMediaPlayer::State newState)
     }
 }
 
+void MainWindow::OnLidOpened(Core::AirPods::DeviceKey key, bool opened)
+{
+    // The focus has been switched to the device in `UpdateState`, which is queued before this
+    //
+    if (opened) {
+        show();
+    }
+    else if (key == _focusedDevice) {
+        DoHide();
+    }
+}
+
 void MainWindow::DoHide()
 {
     // LOG(Trace, "MainWindow: Hide");
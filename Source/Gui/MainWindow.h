@@ -54,20 +54,27 @@ public:
         return _apdMgr;
     }
 
-    void UpdateState(const Core::AirPods::State &state);
+    void UpdateState(
+        Core::AirPods::DeviceKey key, const Core::AirPods::State &state,
+        Core::AirPods::StateFields changedFields);
     void Available();
     void Unavailable();
     void Disconnect();
+    void DisconnectDevice(Core::AirPods::DeviceKey key);
     void Bind();
     void Unbind();
+    void BindAnotherDevice();
 
 Q_SIGNALS:
-    void UpdateStateSafely(const Core::AirPods::State &state);
+    void UpdateStateSafely(
+        Core::AirPods::DeviceKey key, const Core::AirPods::State &state,
+        Core::AirPods::StateFields changedFields);
     void AvailableSafely();
     void UnavailableSafely();
-    void DisconnectSafely();
+    void DisconnectDeviceSafely(Core::AirPods::DeviceKey key);
     void BindSafely();
     void UnbindSafely();
+    void LidOpenedSafely(Core::AirPods::DeviceKey key, bool opened);
     void ShowSafely();
     void HideSafely();
 
@@ -89,7 +96,9 @@ private:
     std::optional<Core::AirPods::Model> _cacheModel;
     ButtonAction _buttonAction{ButtonAction::NoButton};
     Status _status{Status::Unavailable};
+    std::optional<Core::AirPods::DeviceKey> _focusedDevice; // The one shown in the window
     std::optional<Core::AirPods::State> _cachedState;
+    std::vector<std::pair<Core::AirPods::DeviceKey, Core::AirPods::State>> _deviceStates;
     bool _isVisible{false};
     bool _isAnimationPlaying{false};
 
@@ -97,15 +106,18 @@ private:
     void SetAnimation(std::optional<Core::AirPods::Model> model);
     void PlayAnimation();
     void StopAnimation();
+    std::optional<Core::Bluetooth::Device> SelectDevice();
     void BindDevice();
     void ControlAutoHideTimer(bool start);
     void Repaint();
+    void RepaintState(Core::AirPods::StateFields fields);
 
     void OnAppStateChanged(Qt::ApplicationState state);
     void OnPosMoveFinished();
     void OnAnimationClicked();
     void OnButtonClicked();
     void OnPlayerStateChanged(QMediaPlayer::State newState);
+    void OnLidOpened(Core::AirPods::DeviceKey key, bool opened);
 
     void DoHide();
     void showEvent(QShowEvent *event) override;
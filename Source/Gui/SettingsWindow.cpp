@@ -378,7 +378,10 @@ void SettingsWindow::On_cbAutoRun_toggled(bool checked)
 void SettingsWindow::On_pbUnbind_clicked()
 {
     _ui.pbUnbind->setDisabled(true);
-    ModifiableAccess()->device_address = 0;
+
+    auto access = ModifiableAccess();
+    access->device_address = 0;
+    access->extra_device_addresses.clear();
 }
 
 void SettingsWindow::On_cbDisplayBatteryOnTrayIcon_toggled(TrayIconBatteryBehavior behavior)
@@ -31,6 +31,7 @@ namespace Gui {
 TrayIcon::TrayIcon()
 {
     connect(_actionNewVersion, &QAction::triggered, this, &TrayIcon::OnNewVersionClicked);
+    connect(_actionBindAnother, &QAction::triggered, this, &TrayIcon::OnBindAnotherClicked);
     connect(_actionSettings, &QAction::triggered, this, &TrayIcon::OnSettingsClicked);
     connect(_actionAbout, &QAction::triggered, this, &TrayIcon::OnAboutClicked);
     connect(_actionQuit, &QAction::triggered, qApp, &QApplication::quit, Qt::QueuedConnection);
@@ -44,6 +45,7 @@ TrayIcon::TrayIcon()
 
     _menu->addAction(_actionNewVersion);
     _menu->addSeparator();
+    _menu->addAction(_actionBindAnother);
     _menu->addAction(_actionSettings);
     _menu->addSeparator();
     _menu->addAction(_actionAbout);
@@ -54,31 +56,66 @@ TrayIcon::TrayIcon()
     _tray->show();
 }
 
-void TrayIcon::UpdateState(const Core::AirPods::State &state)
+void TrayIcon::UpdateState(
+    Core::AirPods::DeviceKey key, const Core::AirPods::State &state,
+    Core::AirPods::StateFields changedFields)
 {
+    using Core::AirPods::StateField;
+
+    // The tooltip and the icon only show the name, batteries and charging states
+    //
+    constexpr Core::AirPods::StateFields kDisplayedFields =
+        StateField::Model | StateField::LeftBattery | StateField::LeftCharging |
+        StateField::RightBattery | StateField::RightCharging | StateField::CaseBattery |
+        StateField::CaseCharging;
+
+    auto iter = std::find_if(_airPodsStates.begin(), _airPodsStates.end(), [&](const auto &pair) {
+        return pair.first == key;
+    });
+
+    const bool doRepaint = _status != Status::Updating || iter == _airPodsStates.end() ||
+                           (changedFields & kDisplayedFields) != 0;
+
     _status = Status::Updating;
-    _airPodsState = state;
-    Repaint();
+    if (iter == _airPodsStates.end()) {
+        _airPodsStates.emplace_back(key, state);
+    }
+    else {
+        iter->second = state;
+    }
+    if (doRepaint) {
+        Repaint();
+    }
 }
 
 void TrayIcon::Unavailable()
 {
     _status = Status::Unavailable;
-    _airPodsState.reset();
+    _airPodsStates.clear();
     Repaint();
 }
 
 void TrayIcon::Disconnect()
 {
     _status = Status::Disconnected;
-    _airPodsState.reset();
+    _airPodsStates.clear();
+    Repaint();
+}
+
+void TrayIcon::Disconnect(Core::AirPods::DeviceKey key)
+{
+    std::erase_if(_airPodsStates, [&](const auto &pair) { return pair.first == key; });
+
+    if (_status == Status::Updating && _airPodsStates.empty()) {
+        _status = Status::Disconnected;
+    }
     Repaint();
 }
 
 void TrayIcon::Unbind()
 {
     _status = Status::Unbind;
-    _airPodsState.reset();
+    _airPodsStates.clear();
     Repaint();
 }
 
@@ -99,52 +136,57 @@ void TrayIcon::Repaint()
         toolTipContent = DisplayableStatus(_status);
         break;
     case Status::Updating: {
-        if (!_airPodsState.has_value()) {
-            break;
-        }
-        const auto &state = _airPodsState.value();
-
-        toolTipContent += state.displayName;
-
         const auto strLeft{tr("Left")}, strRight{tr("Right")}, strCase{tr("Case")},
             strCharging{tr("charging")};
 
         const auto textCharging = QString{" (%1)"}.arg(strCharging),
                    textPlaceHolder = QString{"\n%1: %2%%3"};
 
-        // clang-format off
-        if (state.pods.left.battery.Available()) {
-            const auto batteryValue = state.pods.left.battery.Value();
+        const auto updateMinBattery = [&](Core::AirPods::Battery::ValueType batteryValue) {
+            if (!minBattery.Available() || batteryValue < minBattery.Value()) {
+                minBattery = batteryValue;
+            }
+        };
+
+        // The lowest battery of all devices is drawn on the icon
+        //
+        for (const auto &[key, state] : _airPodsStates) {
+            if (!toolTipContent.isEmpty()) {
+                toolTipContent += "\n";
+            }
+            toolTipContent += state.displayName;
 
-            toolTipContent += textPlaceHolder
-                .arg(strLeft)
-                .arg(batteryValue)
-                .arg(state.pods.left.isCharging ? textCharging : QString{});
+            // clang-format off
+            if (state.pods.left.battery.Available()) {
+                const auto batteryValue = state.pods.left.battery.Value();
 
-            minBattery = batteryValue;
-        }
+                toolTipContent += textPlaceHolder
+                    .arg(strLeft)
+                    .arg(batteryValue)
+                    .arg(state.pods.left.isCharging ? textCharging : QString{});
 
-        if (state.pods.right.battery.Available()) {
-            const auto batteryValue = state.pods.right.battery.Value();
+                updateMinBattery(batteryValue);
+            }
 
-            toolTipContent += textPlaceHolder
-                .arg(strRight)
-                .arg(batteryValue)
-                .arg(state.pods.right.isCharging ? textCharging : QString{});
+            if (state.pods.right.battery.Available()) {
+                const auto batteryValue = state.pods.right.battery.Value();
 
-            if (minBattery.Available() && batteryValue < minBattery.Value() ||
-                !minBattery.Available()) {
-                minBattery = batteryValue;
+                toolTipContent += textPlaceHolder
+                    .arg(strRight)
+                    .arg(batteryValue)
+                    .arg(state.pods.right.isCharging ? textCharging : QString{});
+
+                updateMinBattery(batteryValue);
             }
-        }
 
-        if (state.caseBox.battery.Available()) {
-            toolTipContent += textPlaceHolder
-                .arg(strCase)
-                .arg(state.caseBox.battery.Value())
-                .arg(state.caseBox.isCharging ? textCharging : QString{});
+            if (state.caseBox.battery.Available()) {
+                toolTipContent += textPlaceHolder
+                    .arg(strCase)
+                    .arg(state.caseBox.battery.Value())
+                    .arg(state.caseBox.isCharging ? textCharging : QString{});
+            }
+            // clang-format on
         }
-        // clang-format on
         break;
     }
     default:
@@ -292,6 +334,11 @@ std::optional<QImage> TrayIcon::GenerateIcon(
     return result;
 }
 
+void TrayIcon::OnBindAnotherClicked()
+{
+    ApdApp->GetMainWindow()->BindAnotherDevice();
+}
+
 void TrayIcon::OnSettingsClicked()
 {
     if (!_settingsWindow.isVisible() ||
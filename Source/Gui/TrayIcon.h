@@ -51,9 +51,12 @@ public:
         return _tray->toolTip();
     }
 
-    void UpdateState(const Core::AirPods::State &state);
+    void UpdateState(
+        Core::AirPods::DeviceKey key, const Core::AirPods::State &state,
+        Core::AirPods::StateFields changedFields);
     void Unavailable();
     void Disconnect();
+    void Disconnect(Core::AirPods::DeviceKey key);
     void Unbind();
 
 Q_SIGNALS:
@@ -63,13 +66,16 @@ private:
     QSystemTrayIcon *_tray = new QSystemTrayIcon{this};
     QMenu *_menu = new QMenu{this};
     QAction *_actionNewVersion = new QAction{tr("New version available!"), this};
+    QAction *_actionBindAnother = new QAction{tr("Bind another device"), this};
     QAction *_actionSettings = new QAction{tr("Settings"), this};
     QAction *_actionAbout = new QAction{tr("About"), this};
     QAction *_actionQuit = new QAction{tr("Quit"), this};
     Core::Settings::TrayIconBatteryBehavior _trayIconBatteryBehavior{
         Core::Settings::TrayIconBatteryBehavior::Disable};
     Status _status{Status::Unavailable};
-    std::optional<Core::AirPods::State> _airPodsState;
+    // In the order they are first updated, there are only a few of them
+    //
+    std::vector<std::pair<Core::AirPods::DeviceKey, Core::AirPods::State>> _airPodsStates;
     std::optional<QString> _displayName;
 
     void ShowMainWindow();
@@ -79,6 +85,7 @@ private:
     GenerateIcon(int size, const std::optional<QString> &optText, const std::optional<QColor> &dot);
 
     void OnNewVersionClicked();
+    void OnBindAnotherClicked();
     void OnSettingsClicked();
     void OnAboutClicked();
     void OnIconClicked(QSystemTrayIcon::ActivationReason reason);
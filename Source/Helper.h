@@ -19,8 +19,13 @@
 #pragma once
 
 #include <mutex>
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <chrono>
+#include <string>
+#include <cwctype>
+#include <algorithm>
 #include <thread>
 #include <future>
 #include <functional>
@@ -59,6 +64,40 @@ Overloaded(Ts...) -> Overloaded<Ts...>;
 
 //////////////////////////////////////////////////
 
+namespace Text {
+
+[[nodiscard]] constexpr std::string ToLower(std::string source)
+{
+    std::transform(source.begin(), source.end(), source.begin(), [](unsigned char ch) {
+        return static_cast<char>(std::tolower(ch));
+    });
+    return source;
+}
+
+[[nodiscard]] constexpr std::wstring ToLower(std::wstring source)
+{
+    std::transform(source.begin(), source.end(), source.begin(), &std::towlower);
+    return source;
+}
+
+[[nodiscard]] constexpr std::string ToUpper(std::string source)
+{
+    std::transform(source.begin(), source.end(), source.begin(), [](unsigned char ch) {
+        return static_cast<char>(std::toupper(ch));
+    });
+    return source;
+}
+
+[[nodiscard]] constexpr std::wstring ToUpper(std::wstring source)
+{
+    std::transform(source.begin(), source.end(), source.begin(), &std::towupper);
+    return source;
+}
+
+} // namespace Text
+
+//////////////////////////////////////////////////
+
 class NonCopyable
 {
 protected:
@@ -170,16 +209,24 @@ struct Sides {
 
 using CbHandle = uint64_t;
 
+// Callbacks are stored in an immutable list. `Invoke` iterates over a snapshot of the list without
+// locking, and modifications copy the list and swap the new one in. So callbacks can register or
+// unregister callbacks, and a slow callback doesn't block modifications from other threads.
+//
 template <class Function>
 class Callback
 {
 public:
+    using CallbackList = std::vector<std::pair<CbHandle, Function>>;
+
     inline CbHandle Register(Function &&callback)
     {
         std::lock_guard<std::mutex> lock{_mutex};
 
         auto thisHandle = _nextHandle++;
-        _callbacks.emplace_back(thisHandle, std::move(callback));
+        auto callbacks = std::make_shared<CallbackList>(*_callbacks.load());
+        callbacks->emplace_back(thisHandle, std::move(callback));
+        _callbacks = std::move(callbacks);
         return thisHandle;
     }
 
@@ -187,16 +234,19 @@ public:
     {
         std::lock_guard<std::mutex> lock{_mutex};
 
+        auto current = _callbacks.load();
         auto iter =
-            std::find_if(_callbacks.begin(), _callbacks.end(), [handle](const auto &callbackInfo) {
+            std::find_if(current->begin(), current->end(), [handle](const auto &callbackInfo) {
                 return callbackInfo.first == handle;
             });
 
-        if (iter == _callbacks.end()) {
+        if (iter == current->end()) {
             return false;
         }
 
-        _callbacks.erase(iter);
+        auto callbacks = std::make_shared<CallbackList>(*current);
+        callbacks->erase(callbacks->begin() + std::distance(current->begin(), iter));
+        _callbacks = std::move(callbacks);
         return true;
     }
 
@@ -204,15 +254,15 @@ public:
     {
         std::lock_guard<std::mutex> lock{_mutex};
 
-        _callbacks.clear();
+        _callbacks = std::make_shared<const CallbackList>();
     }
 
     template <class... Args>
     inline void Invoke(Args &&...args) const
     {
-        std::lock_guard<std::mutex> lock{_mutex};
+        const auto callbacks = _callbacks.load();
 
-        for (const auto &callbackInfo : _callbacks) {
+        for (const auto &callbackInfo : *callbacks) {
             callbackInfo.second(args...);
         }
     }
@@ -223,10 +273,18 @@ public:
         return *this;
     }
 
+    // The snapshot `Invoke` iterates over, which stays valid after the `Callback` is destroyed
+    //
+    inline std::shared_ptr<const CallbackList> GetSnapshot() const
+    {
+        return _callbacks.load();
+    }
+
 private:
-    mutable std::mutex _mutex;
+    std::mutex _mutex; // Serializes modifications only
     CbHandle _nextHandle{1};
-    std::vector<std::pair<CbHandle, Function>> _callbacks;
+    std::atomic<std::shared_ptr<const CallbackList>> _callbacks{
+        std::make_shared<const CallbackList>()};
 };
 
 class ConWorker
@@ -289,6 +347,144 @@ private:
     }
 };
 
+namespace Details {
+
+// A process-wide scheduler driving all `Timer`s from a single thread.
+//
+// Timers are kept in a min-heap ordered by the deadline they were pushed with. `Timer::Reset()`
+// only stores a later deadline into the timer, when the stale heap entry is popped the timer is
+// pushed again with its current deadline instead of being triggered.
+//
+class TimerScheduler : public Singleton<TimerScheduler>
+{
+protected:
+    friend Singleton<TimerScheduler>;
+
+    inline TimerScheduler()
+    {
+        _thread = std::thread{&TimerScheduler::Thread, this};
+    }
+
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimePoint = Clock::time_point;
+
+    struct Entry {
+        std::function<void()> callback;
+        std::atomic<std::chrono::milliseconds> interval;
+        std::atomic<TimePoint> deadline;
+        bool active{true}; // Guarded by the scheduler mutex
+    };
+
+    inline ~TimerScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            _destroyFlag = true;
+        }
+        _conVar.notify_all();
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+    inline void Add(std::shared_ptr<Entry> entry)
+    {
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            Push(std::move(entry));
+        }
+        _conVar.notify_all();
+    }
+
+    // Waits for the callback of the entry to finish if it's running, unless we are called from
+    // the callback itself.
+    //
+    inline void Remove(const std::shared_ptr<Entry> &entry)
+    {
+        std::unique_lock<std::mutex> lock{_mutex};
+
+        entry->active = false;
+        if (std::this_thread::get_id() != _thread.get_id()) {
+            _conVar.wait(lock, [&] { return _running != entry.get(); });
+        }
+    }
+
+private:
+    using HeapItem = std::pair<TimePoint, std::shared_ptr<Entry>>;
+
+    std::mutex _mutex;
+    std::condition_variable _conVar;
+    std::vector<HeapItem> _heap;
+    Entry *_running{nullptr};
+    bool _destroyFlag{false};
+    std::thread _thread;
+
+    static inline bool HeapCompare(const HeapItem &lhs, const HeapItem &rhs)
+    {
+        return lhs.first > rhs.first;
+    }
+
+    inline void Push(std::shared_ptr<Entry> entry)
+    {
+        const auto deadline = entry->deadline.load();
+        _heap.emplace_back(deadline, std::move(entry));
+        std::push_heap(_heap.begin(), _heap.end(), &HeapCompare);
+    }
+
+    inline void Thread()
+    {
+        std::unique_lock<std::mutex> lock{_mutex};
+
+        while (!_destroyFlag) {
+            if (_heap.empty()) {
+                _conVar.wait(lock);
+                continue;
+            }
+
+            const auto top = _heap.front().first;
+            if (top > Clock::now()) {
+                _conVar.wait_until(lock, top);
+                continue;
+            }
+
+            std::pop_heap(_heap.begin(), _heap.end(), &HeapCompare);
+            auto entry = std::move(_heap.back().second);
+            _heap.pop_back();
+
+            if (!entry->active) {
+                continue;
+            }
+
+            // Reset since it was pushed, reschedule it with the new deadline
+            //
+            const auto now = Clock::now();
+            if (entry->deadline.load() > now) {
+                Push(std::move(entry));
+                continue;
+            }
+
+            entry->deadline = now + entry->interval.load();
+
+            _running = entry.get();
+            lock.unlock();
+            entry->callback();
+            lock.lock();
+            _running = nullptr;
+            _conVar.notify_all();
+
+            if (entry->active) {
+                Push(std::move(entry));
+            }
+        }
+    }
+};
+} // namespace Details
+
+// Calls the callback every interval, the countdown restarts on `Reset()`.
+//
+// All timers share the thread of `Details::TimerScheduler`, so callbacks should be short.
+//
 class Timer
 {
 public:
@@ -311,61 +507,34 @@ public:
     Start(std::chrono::milliseconds interval, FnTrigger callback, bool immediatelyOnce = false)
     {
         Stop();
-        _destroyFlag = false;
-        _interval = std::move(interval);
-        _thread =
-            std::thread{&Timer::Thread, this, std::move(callback), immediatelyOnce};
+
+        auto entry = std::make_shared<Details::TimerScheduler::Entry>();
+        entry->callback = std::move(callback);
+        entry->interval = interval;
+        entry->deadline = immediatelyOnce ? Clock::now() : Clock::now() + interval;
+
+        _entry = entry;
+        Details::TimerScheduler::GetInstance().Add(std::move(entry));
     }
 
     inline void Stop()
     {
-        _destroyFlag = true;
-        _destroyConVar.notify_all();
-        if (_thread.joinable()) {
-            _thread.join();
+        if (_entry) {
+            Details::TimerScheduler::GetInstance().Remove(_entry);
+            _entry.reset();
         }
     }
 
     inline void Reset()
     {
-        _deadline = Clock::now() + _interval.load();
+        if (_entry) {
+            _entry->deadline = Clock::now() + _entry->interval.load();
+        }
     }
 
 private:
-    using Clock = std::chrono::steady_clock;
-    using TimePoint = Clock::time_point;
-
-    std::atomic<bool> _destroyFlag{false};
-    std::mutex _mutex;
-    std::condition_variable _destroyConVar;
-    std::atomic<std::chrono::milliseconds> _interval;
-    std::atomic<TimePoint> _deadline;
-    std::thread _thread;
+    using Clock = Details::TimerScheduler::Clock;
 
-    inline void Thread(FnTrigger callback, bool immediatelyOnce)
-    {
-        if (immediatelyOnce) {
-            callback();
-        }
-
-        Reset();
-
-        while (true) {
-            std::unique_lock<std::mutex> lock{_mutex};
-            {
-                _destroyConVar.wait_until(lock, _deadline.load());
-            }
-            lock.unlock();
-
-            if (_destroyFlag) {
-                break;
-            }
-            if (_deadline.load() > Clock::now()) {
-                continue;
-            }
-            Reset();
-            callback();
-        }
-    }
+    std::shared_ptr<Details::TimerScheduler::Entry> _entry;
 };
 } // namespace Helper
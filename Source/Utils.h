@@ -141,38 +141,6 @@ inline void BreakPoint()
 }
 } // namespace Debug
 
-namespace Text {
-
-[[nodiscard]] constexpr std::string ToLower(std::string source)
-{
-    std::transform(source.begin(), source.end(), source.begin(), [](unsigned char ch) {
-        return static_cast<char>(std::tolower(ch));
-    });
-    return source;
-}
-
-[[nodiscard]] constexpr std::wstring ToLower(std::wstring source)
-{
-    std::transform(source.begin(), source.end(), source.begin(), &std::towlower);
-    return source;
-}
-
-[[nodiscard]] constexpr std::string ToUpper(std::string source)
-{
-    std::transform(source.begin(), source.end(), source.begin(), [](unsigned char ch) {
-        return static_cast<char>(std::toupper(ch));
-    });
-    return source;
-}
-
-[[nodiscard]] constexpr std::wstring ToUpper(std::wstring source)
-{
-    std::transform(source.begin(), source.end(), source.begin(), &std::towupper);
-    return source;
-}
-
-} // namespace Text
-
 namespace File {
 
 inline QDir GetWorkspace()
@@ -0,0 +1,104 @@
+//
+// AirPodsDesktop - AirPods Desktop User Experience Enhancement Program.
+// Copyright (C) 2021-2022 SpriteOvO
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "Core/AppleCPBatch.h"
+
+using namespace Core;
+
+namespace {
+
+// Valid headers followed by random bytes, so every bit of the decoded fields is exercised
+//
+std::vector<AppleCP::Batch::Payload> MakeRandomPayloads(size_t count, uint32_t seed)
+{
+    std::mt19937 rng{seed};
+    std::uniform_int_distribution<int> byteDist{0, 255};
+
+    std::vector<AppleCP::Batch::Payload> result(count);
+    for (auto &payload : result) {
+        for (auto &byte : payload) {
+            byte = static_cast<uint8_t>(byteDist(rng));
+        }
+        payload[0] = Helper::ToUnderlying(AppleCP::PacketType::ProximityPairing);
+        payload[1] = sizeof(AppleCP::AirPods) - sizeof(AppleCP::Header);
+    }
+    return result;
+}
+
+AirPods::Battery ToBattery(uint8_t value)
+{
+    return value <= 10 ? AirPods::Battery{value} : AirPods::Battery{};
+}
+
+// Compares the batch results with the accessors of `AppleCP::AirPods` for each payload
+//
+void ExpectSameAsAccessors(std::span<const AppleCP::Batch::Payload> payloads)
+{
+    AppleCP::Batch::Decoded decoded;
+    AppleCP::Batch::Decode(payloads, decoded);
+
+    ASSERT_EQ(decoded.Size(), payloads.size());
+
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        SCOPED_TRACE(testing::Message() << "size " << payloads.size() << ", index " << i);
+
+        const auto view = AppleCP::ViewAs<AppleCP::AirPods>(payloads[i]);
+        ASSERT_TRUE(view.has_value());
+
+        const auto &airPods = **view;
+
+        EXPECT_EQ(decoded.model[i], airPods.GetModel());
+
+        EXPECT_EQ(ToBattery(decoded.leftBattery[i]), airPods.GetLeftBattery());
+        EXPECT_EQ(ToBattery(decoded.rightBattery[i]), airPods.GetRightBattery());
+        EXPECT_EQ(ToBattery(decoded.caseBattery[i]), airPods.GetCaseBattery());
+
+        EXPECT_EQ((decoded.charging[i] & AppleCP::Batch::Bit::Left) != 0, airPods.IsLeftCharging());
+        EXPECT_EQ(
+            (decoded.charging[i] & AppleCP::Batch::Bit::Right) != 0, airPods.IsRightCharging());
+        EXPECT_EQ((decoded.charging[i] & AppleCP::Batch::Bit::Case) != 0, airPods.IsCaseCharging());
+
+        EXPECT_EQ((decoded.inEar[i] & AppleCP::Batch::Bit::Left) != 0, airPods.IsLeftInEar());
+        EXPECT_EQ((decoded.inEar[i] & AppleCP::Batch::Bit::Right) != 0, airPods.IsRightInEar());
+
+        EXPECT_EQ(decoded.lidOpened[i] != 0, airPods.IsLidOpened());
+    }
+}
+} // namespace
+
+// Not a multiple of 16, so the vectorized body and the scalar tail are both covered
+//
+TEST(AppleCPBatch, MatchesAccessors)
+{
+    const auto payloads = MakeRandomPayloads(16 * 64 + 7, 2022);
+    ExpectSameAsAccessors(payloads);
+}
+
+// Batches shorter than, equal to and just above the vector width
+//
+TEST(AppleCPBatch, MatchesAccessorsForShortBatches)
+{
+    const auto payloads = MakeRandomPayloads(40, 2021);
+    for (size_t size = 0; size <= payloads.size(); ++size) {
+        ExpectSameAsAccessors(std::span{payloads}.first(size));
+    }
+}
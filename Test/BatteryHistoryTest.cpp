@@ -0,0 +1,188 @@
+//
+// AirPodsDesktop - AirPods Desktop User Experience Enhancement Program.
+// Copyright (C) 2021-2022 SpriteOvO
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <fstream>
+#include <filesystem>
+#include <gtest/gtest.h>
+
+#include "Core/BatteryHistory.h"
+
+using namespace Core;
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr uint64_t kKey = 0x112233445566;
+const BatteryHistory::Clock::time_point kEpoch{1'600'000'000s};
+
+BatteryHistory::Sample MakeSample(
+    std::chrono::milliseconds offset, AirPods::Battery::ValueType battery, uint8_t charging = 0,
+    uint64_t key = kKey)
+{
+    return BatteryHistory::Sample{
+        .time = kEpoch + offset,
+        .key = key,
+        .left = battery,
+        .right = battery,
+        .caseBox = {},
+        .charging = charging};
+}
+
+// A history file of its own for each test, removed afterwards
+//
+class BatteryHistoryTest : public testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        _path = std::filesystem::temp_directory_path() /
+                (std::string{"BatteryHistoryTest."} +
+                 testing::UnitTest::GetInstance()->current_test_info()->name() + ".bin");
+        std::filesystem::remove(_path);
+    }
+
+    void TearDown() override
+    {
+        _history.Close();
+        std::filesystem::remove(_path);
+    }
+
+    std::vector<BatteryHistory::Sample> QueryAll(size_t maxPoints = 1000) const
+    {
+        return _history.Query(kKey, kEpoch, kEpoch + 1000s, maxPoints);
+    }
+
+    std::filesystem::path _path;
+    BatteryHistory::History _history;
+};
+} // namespace
+
+TEST_F(BatteryHistoryTest, KeepsTheLatestSamplesAcrossReopening)
+{
+    constexpr size_t kCapacity = 8;
+
+    ASSERT_TRUE(_history.Open(_path, kCapacity));
+    for (int i = 0; i < 12; ++i) {
+        _history.Append(MakeSample(i * 1s, i));
+    }
+    _history.Close();
+
+    ASSERT_TRUE(_history.Open(_path, kCapacity));
+    const auto samples = QueryAll();
+
+    // The first 4 samples are overwritten
+    //
+    ASSERT_EQ(samples.size(), kCapacity);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        SCOPED_TRACE(testing::Message() << "index " << i);
+
+        const auto expected = static_cast<int>(i) + 4;
+        EXPECT_EQ(samples[i].time, kEpoch + expected * 1s);
+        EXPECT_EQ(samples[i].key, kKey);
+        EXPECT_EQ(samples[i].left, AirPods::Battery{static_cast<uint32_t>(expected)});
+        EXPECT_EQ(samples[i].right, AirPods::Battery{static_cast<uint32_t>(expected)});
+        EXPECT_FALSE(samples[i].caseBox.Available());
+    }
+}
+
+TEST_F(BatteryHistoryTest, ResetsOnCapacityMismatch)
+{
+    ASSERT_TRUE(_history.Open(_path, 8));
+    _history.Append(MakeSample(1s, 50));
+    _history.Close();
+
+    ASSERT_TRUE(_history.Open(_path, 16));
+    EXPECT_TRUE(QueryAll().empty());
+
+    _history.Append(MakeSample(2s, 60));
+    EXPECT_EQ(QueryAll().size(), 1);
+}
+
+TEST_F(BatteryHistoryTest, ResetsOnCorruptedMagic)
+{
+    ASSERT_TRUE(_history.Open(_path, 8));
+    _history.Append(MakeSample(1s, 50));
+    _history.Close();
+
+    {
+        std::fstream file{_path, std::ios::in | std::ios::out | std::ios::binary};
+        ASSERT_TRUE(file.is_open());
+        file.write("XXXX", 4);
+    }
+
+    ASSERT_TRUE(_history.Open(_path, 8));
+    EXPECT_TRUE(QueryAll().empty());
+}
+
+TEST_F(BatteryHistoryTest, DownsamplesIntoBuckets)
+{
+    ASSERT_TRUE(_history.Open(_path, 64));
+
+    // Two buckets of 500s, the second one has a charging sample and an unavailable battery
+    //
+    _history.Append(MakeSample(100s, 10));
+    _history.Append(MakeSample(200s, 20));
+    _history.Append(MakeSample(300s, 40));
+    _history.Append(MakeSample(600s, 80, BatteryHistory::Bit::Left));
+    _history.Append(MakeSample(700s, 90));
+    _history.Append(BatteryHistory::Sample{
+        .time = kEpoch + 800s, .key = kKey, .left = {}, .right = {}, .caseBox = {}, .charging = 0});
+
+    // Other devices and samples out of the range are ignored
+    //
+    _history.Append(MakeSample(400s, 100, BatteryHistory::Bit::Case, kKey + 1));
+    _history.Append(MakeSample(1000s, 100));
+
+    const auto samples = QueryAll(2);
+    ASSERT_EQ(samples.size(), 2);
+
+    EXPECT_EQ(samples[0].time, kEpoch + 300s);
+    EXPECT_EQ(samples[0].left, AirPods::Battery{23});
+    EXPECT_EQ(samples[0].charging, 0);
+
+    EXPECT_EQ(samples[1].time, kEpoch + 800s);
+    EXPECT_EQ(samples[1].left, AirPods::Battery{85});
+    EXPECT_EQ(samples[1].charging, BatteryHistory::Bit::Left);
+}
+
+// The samples are appended in the order they are received, the clock may have been set back in
+// between
+//
+TEST_F(BatteryHistoryTest, OrdersBucketsWhenTheClockSteppedBack)
+{
+    ASSERT_TRUE(_history.Open(_path, 64));
+
+    _history.Append(MakeSample(500s, 50));
+    _history.Append(MakeSample(900s, 90));
+    _history.Append(MakeSample(100s, 10)); // Set back
+    _history.Append(MakeSample(550s, 60));
+
+    const auto samples = QueryAll(10);
+    ASSERT_EQ(samples.size(), 3);
+
+    EXPECT_EQ(samples[0].time, kEpoch + 100s);
+    EXPECT_EQ(samples[0].left, AirPods::Battery{10});
+
+    // The samples of the same bucket are merged, even though they aren't adjacent
+    //
+    EXPECT_EQ(samples[1].time, kEpoch + 550s);
+    EXPECT_EQ(samples[1].left, AirPods::Battery{55});
+
+    EXPECT_EQ(samples[2].time, kEpoch + 900s);
+    EXPECT_EQ(samples[2].left, AirPods::Battery{90});
+}
@@ -0,0 +1,333 @@
+//
+// AirPodsDesktop - AirPods Desktop User Experience Enhancement Program.
+// Copyright (C) 2021-2022 SpriteOvO
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <array>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <optional>
+#include <condition_variable>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <gtest/gtest.h>
+
+#include "Core/Bluetooth_hci.h"
+
+using namespace Core::Bluetooth;
+using namespace std::chrono_literals;
+
+namespace {
+
+using ReceivedData = AdvertisementWatcher::ReceivedData;
+
+constexpr uint16_t kAppleCompanyId = 0x004C;
+constexpr uint64_t kAddress = 0x112233445566;
+
+// An LE Advertising Report event of AirPods as read from a raw HCI socket, with the RSSI of -60
+//
+constexpr std::array<uint8_t, 46> kLegacyReport{
+    0x04, 0x3E, 0x2B, 0x02, 0x01, 0x00, 0x01, 0x66, 0x55, 0x44, 0x33, 0x22, //
+    0x11, 0x1F, 0x1E, 0xFF, 0x4C, 0x00, 0x07, 0x19, 0x01, 0x0E, 0x20, 0x55, //
+    0xAA, 0x55, 0x31, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC4,             //
+};
+constexpr size_t kLegacyAddressOffset = 7;
+constexpr size_t kLegacyRssiOffset = kLegacyReport.size() - 1;
+
+// The same advertisement in an LE Extended Advertising Report event, with the RSSI of -45
+//
+constexpr std::array<uint8_t, 60> kExtendedReport{
+    0x04, 0x3E, 0x39, 0x0D, 0x01, 0x13, 0x00, 0x01, 0x66, 0x55, 0x44, 0x33, //
+    0x22, 0x11, 0x01, 0x00, 0xFF, 0x7F, 0xD3, 0x00, 0x00, 0x00, 0x00, 0x00, //
+    0x00, 0x00, 0x00, 0x00, 0x1F, 0x1E, 0xFF, 0x4C, 0x00, 0x07, 0x19, 0x01, //
+    0x0E, 0x20, 0x55, 0xAA, 0x55, 0x31, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //
+};
+constexpr size_t kExtendedEventTypeOffset = 5;
+constexpr size_t kExtendedRssiOffset = 18;
+
+// Event types with the data status "incomplete, more data to come" and "complete"
+//
+constexpr uint8_t kExtendedIncomplete = 0x20;
+constexpr uint8_t kExtendedComplete = 0x00;
+
+// The manufacturer data of the advertisement, without the company identifier
+//
+const std::vector<uint8_t> kManufacturerData{
+    0x07, 0x19, 0x01, 0x0E, 0x20, 0x55, 0xAA, 0x55, 0x31, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+template <size_t N>
+std::vector<uint8_t> Patch(const std::array<uint8_t, N> &event, size_t offset, uint8_t value)
+{
+    std::vector<uint8_t> result{event.begin(), event.end()};
+    result.at(offset) = value;
+    return result;
+}
+
+std::vector<uint8_t> CollectManufacturerData(std::span<const uint8_t> data, uint16_t &companyId)
+{
+    std::vector<uint8_t> result;
+    Details::Hci::ForEachManufacturerData(data, [&](uint16_t id, std::span<const uint8_t> bytes) {
+        companyId = id;
+        result.assign(bytes.begin(), bytes.end());
+    });
+    return result;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////
+// ParseEvent
+//
+
+TEST(BluetoothHciParseEvent, LegacyReport)
+{
+    std::vector<Details::Hci::AdvertisingReport> reports;
+    ASSERT_TRUE(Details::Hci::ParseEvent(kLegacyReport, reports));
+    ASSERT_EQ(reports.size(), 1);
+
+    EXPECT_EQ(reports[0].address, kAddress);
+    EXPECT_EQ(reports[0].rssi, -60);
+    EXPECT_EQ(reports[0].status, Details::Hci::DataStatus::Complete);
+
+    uint16_t companyId = 0;
+    EXPECT_EQ(CollectManufacturerData(reports[0].data, companyId), kManufacturerData);
+    EXPECT_EQ(companyId, kAppleCompanyId);
+}
+
+TEST(BluetoothHciParseEvent, ExtendedReport)
+{
+    std::vector<Details::Hci::AdvertisingReport> reports;
+    ASSERT_TRUE(Details::Hci::ParseEvent(kExtendedReport, reports));
+    ASSERT_EQ(reports.size(), 1);
+
+    EXPECT_EQ(reports[0].address, kAddress);
+    EXPECT_EQ(reports[0].rssi, -45);
+    EXPECT_EQ(reports[0].status, Details::Hci::DataStatus::Complete);
+
+    uint16_t companyId = 0;
+    EXPECT_EQ(CollectManufacturerData(reports[0].data, companyId), kManufacturerData);
+    EXPECT_EQ(companyId, kAppleCompanyId);
+}
+
+TEST(BluetoothHciParseEvent, ExtendedReportFragment)
+{
+    const auto event = Patch(kExtendedReport, kExtendedEventTypeOffset, kExtendedIncomplete);
+
+    std::vector<Details::Hci::AdvertisingReport> reports;
+    ASSERT_TRUE(Details::Hci::ParseEvent(event, reports));
+    ASSERT_EQ(reports.size(), 1);
+    EXPECT_EQ(reports[0].status, Details::Hci::DataStatus::Incomplete);
+}
+
+TEST(BluetoothHciParseEvent, RssiUnavailable)
+{
+    std::vector<Details::Hci::AdvertisingReport> reports;
+
+    ASSERT_TRUE(Details::Hci::ParseEvent(
+        Patch(kLegacyReport, kLegacyRssiOffset, Details::Hci::kRssiUnavailable), reports));
+    ASSERT_EQ(reports.size(), 1);
+    EXPECT_EQ(reports[0].rssi, Details::Hci::kRssiUnavailable);
+
+    ASSERT_TRUE(Details::Hci::ParseEvent(
+        Patch(kExtendedReport, kExtendedRssiOffset, Details::Hci::kRssiUnavailable), reports));
+    ASSERT_EQ(reports.size(), 1);
+    EXPECT_EQ(reports[0].rssi, Details::Hci::kRssiUnavailable);
+}
+
+// Every prefix of the events is rejected, and so are reports longer than their event
+//
+TEST(BluetoothHciParseEvent, TruncatedEvents)
+{
+    std::vector<Details::Hci::AdvertisingReport> reports;
+
+    for (size_t size = 0; size < kLegacyReport.size(); ++size) {
+        SCOPED_TRACE(testing::Message() << "size " << size);
+        EXPECT_FALSE(Details::Hci::ParseEvent(std::span{kLegacyReport}.first(size), reports));
+    }
+    for (size_t size = 0; size < kExtendedReport.size(); ++size) {
+        SCOPED_TRACE(testing::Message() << "size " << size);
+        EXPECT_FALSE(Details::Hci::ParseEvent(std::span{kExtendedReport}.first(size), reports));
+    }
+
+    auto event = Patch(kLegacyReport, 2, kLegacyReport[2] - 1);
+    event.pop_back();
+    EXPECT_FALSE(Details::Hci::ParseEvent(event, reports));
+
+    EXPECT_FALSE(Details::Hci::ParseEvent(Patch(kLegacyReport, 4, 2), reports));
+}
+
+//////////////////////////////////////////////////
+// AdvertisementWatcher
+//
+
+namespace {
+
+// The watcher reads the events written to the other end of a `SOCK_SEQPACKET` socketpair, which
+// keeps the boundaries of the events as a raw HCI socket does
+//
+class BluetoothHciWatcherTest : public testing::Test
+{
+protected:
+    constexpr static uint64_t kMarkerAddress = 0xAABBCCDDEEFF;
+
+    void SetUp() override
+    {
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, _sockets.data()), 0);
+
+        _watcher.emplace(_sockets[0]);
+        _watcher->SetFilter([](uint16_t companyId, std::span<const uint8_t>) {
+            return companyId == kAppleCompanyId;
+        });
+        _watcher->CbReceived() += [this](const ReceivedData &data) {
+            std::lock_guard<std::mutex> lock{_mutex};
+            _received.push_back(data);
+            _cv.notify_all();
+        };
+        _watcher->CbStateChanged() += [this](auto state, const auto &optError) {
+            std::lock_guard<std::mutex> lock{_mutex};
+            if (state == AdvertisementWatcher::State::Stopped) {
+                _stopError = optError.value_or("");
+                _cv.notify_all();
+            }
+        };
+
+        ASSERT_TRUE(_watcher->Start());
+    }
+
+    void TearDown() override
+    {
+        _watcher.reset();
+        for (const int socket : _sockets) {
+            if (socket >= 0) {
+                close(socket);
+            }
+        }
+    }
+
+    void Send(std::span<const uint8_t> event)
+    {
+        const auto written = write(_sockets[1], event.data(), event.size());
+        EXPECT_EQ(written, static_cast<ssize_t>(event.size()));
+    }
+
+    // Sends a report from another address and waits for it, so that the events sent before have
+    // been processed. Returns the advertisements received before the marker.
+    //
+    std::vector<ReceivedData> Flush()
+    {
+        auto marker = std::vector<uint8_t>{kLegacyReport.begin(), kLegacyReport.end()};
+        for (size_t i = 0; i < 6; ++i) {
+            marker[kLegacyAddressOffset + i] = static_cast<uint8_t>(kMarkerAddress >> (i * 8));
+        }
+        Send(marker);
+
+        std::unique_lock<std::mutex> lock{_mutex};
+        const bool received = _cv.wait_for(lock, 2s, [&] {
+            return !_received.empty() && _received.back().address == kMarkerAddress;
+        });
+        EXPECT_TRUE(received);
+
+        auto result = std::move(_received);
+        _received.clear();
+        if (received) {
+            result.pop_back();
+        }
+        return result;
+    }
+
+    std::array<int, 2> _sockets{-1, -1};
+    std::optional<AdvertisementWatcher> _watcher;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::vector<ReceivedData> _received;
+    std::optional<std::string> _stopError;
+};
+} // namespace
+
+TEST_F(BluetoothHciWatcherTest, ReceivesLegacyAndExtendedReports)
+{
+    Send(kLegacyReport);
+    Send(kExtendedReport);
+
+    const auto received = Flush();
+    ASSERT_EQ(received.size(), 2);
+
+    EXPECT_EQ(received[0].address, kAddress);
+    EXPECT_EQ(received[0].rssi, -60);
+    EXPECT_EQ(received[1].address, kAddress);
+    EXPECT_EQ(received[1].rssi, -45);
+
+    for (const auto &data : received) {
+        ASSERT_EQ(data.manufacturerDataMap.size(), 1);
+        EXPECT_EQ(data.manufacturerDataMap.at(kAppleCompanyId), kManufacturerData);
+    }
+}
+
+TEST_F(BluetoothHciWatcherTest, DropsFilteredOutAdvertisements)
+{
+    // The company identifier follows the AD type of the manufacturer data
+    //
+    Send(Patch(kLegacyReport, 16, 0x75));
+    EXPECT_TRUE(Flush().empty());
+}
+
+TEST_F(BluetoothHciWatcherTest, DropsReportsWithoutRssi)
+{
+    Send(Patch(kLegacyReport, kLegacyRssiOffset, Details::Hci::kRssiUnavailable));
+    Send(Patch(kExtendedReport, kExtendedRssiOffset, Details::Hci::kRssiUnavailable));
+    EXPECT_TRUE(Flush().empty());
+}
+
+TEST_F(BluetoothHciWatcherTest, DropsTruncatedEvents)
+{
+    for (size_t size = 1; size < kLegacyReport.size(); size += 5) {
+        Send(std::span{kLegacyReport}.first(size));
+    }
+    for (size_t size = 1; size < kExtendedReport.size(); size += 5) {
+        Send(std::span{kExtendedReport}.first(size));
+    }
+    EXPECT_TRUE(Flush().empty());
+}
+
+// The last fragment of a chain is reported as complete, but it isn't a whole advertisement
+//
+TEST_F(BluetoothHciWatcherTest, DropsFragmentedAdvertisements)
+{
+    Send(Patch(kExtendedReport, kExtendedEventTypeOffset, kExtendedIncomplete));
+    Send(Patch(kExtendedReport, kExtendedEventTypeOffset, kExtendedIncomplete));
+    Send(Patch(kExtendedReport, kExtendedEventTypeOffset, kExtendedComplete));
+    EXPECT_TRUE(Flush().empty());
+
+    // The chain has ended
+    //
+    Send(kExtendedReport);
+    EXPECT_EQ(Flush().size(), 1);
+}
+
+TEST_F(BluetoothHciWatcherTest, StopsWhenTheSocketIsClosed)
+{
+    close(_sockets[1]);
+    _sockets[1] = -1;
+
+    std::unique_lock<std::mutex> lock{_mutex};
+    ASSERT_TRUE(_cv.wait_for(lock, 2s, [&] { return _stopError.has_value(); }));
+    EXPECT_EQ(_stopError.value(), "The HCI socket is closed.");
+}
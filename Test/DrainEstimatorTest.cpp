@@ -0,0 +1,155 @@
+//
+// AirPodsDesktop - AirPods Desktop User Experience Enhancement Program.
+// Copyright (C) 2021-2022 SpriteOvO
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "Core/AirPods.h"
+
+using namespace Core::AirPods;
+using namespace std::chrono_literals;
+
+namespace {
+
+using Details::DrainEstimator;
+
+const DrainEstimator::Clock::time_point kStart{1000h};
+
+// The estimates are truncated to whole seconds from a float rate
+//
+void ExpectSeconds(std::optional<std::chrono::seconds> actual, std::chrono::seconds expected)
+{
+    ASSERT_TRUE(actual.has_value());
+    EXPECT_NEAR(actual->count(), expected.count(), 1);
+}
+} // namespace
+
+TEST(DrainEstimator, NoRateUntilTheSecondStep)
+{
+    DrainEstimator estimator;
+
+    estimator.Update(80, false, kStart);
+    EXPECT_FALSE(estimator.GetTimeToEmpty().has_value());
+
+    // The battery may have been at 80% for a while before, this step isn't measured
+    //
+    estimator.Update(70, false, kStart + 10min);
+    EXPECT_FALSE(estimator.GetTimeToEmpty().has_value());
+
+    // Repeats of the same value don't move the time of the last step
+    //
+    estimator.Update(70, false, kStart + 15min);
+    EXPECT_FALSE(estimator.GetTimeToEmpty().has_value());
+
+    // 10% per 10 minutes
+    //
+    estimator.Update(60, false, kStart + 20min);
+    ExpectSeconds(estimator.GetTimeToEmpty(), 60min);
+    EXPECT_FALSE(estimator.GetTimeToFull().has_value());
+}
+
+TEST(DrainEstimator, BlendsRatesByEwma)
+{
+    DrainEstimator estimator;
+
+    estimator.Update(80, false, kStart);
+    estimator.Update(70, false, kStart + 10min);
+    estimator.Update(60, false, kStart + 20min); // 1% per minute
+    estimator.Update(50, false, kStart + 40min); // 0.5% per minute
+
+    const float rate = DrainEstimator::kRateSmoothing * 0.5f +
+                       (1.f - DrainEstimator::kRateSmoothing) * 1.f; // Percent per minute
+    ExpectSeconds(
+        estimator.GetTimeToEmpty(),
+        std::chrono::seconds{static_cast<int64_t>(50.f / rate * 60.f)});
+}
+
+TEST(DrainEstimator, ResetsWhenChargingFlips)
+{
+    DrainEstimator estimator;
+
+    estimator.Update(80, false, kStart);
+    estimator.Update(70, false, kStart + 10min);
+    estimator.Update(60, false, kStart + 20min);
+    ASSERT_TRUE(estimator.GetTimeToEmpty().has_value());
+
+    // The first charging step isn't measured either
+    //
+    estimator.Update(60, true, kStart + 21min);
+    EXPECT_FALSE(estimator.GetTimeToEmpty().has_value());
+    EXPECT_FALSE(estimator.GetTimeToFull().has_value());
+
+    estimator.Update(70, true, kStart + 25min);
+    EXPECT_FALSE(estimator.GetTimeToFull().has_value());
+
+    estimator.Update(80, true, kStart + 30min); // 2% per minute
+    ExpectSeconds(estimator.GetTimeToFull(), 10min);
+    EXPECT_FALSE(estimator.GetTimeToEmpty().has_value());
+}
+
+TEST(DrainEstimator, ResetsWhenTheBatteryBecomesUnavailable)
+{
+    DrainEstimator estimator;
+
+    estimator.Update(80, false, kStart);
+    estimator.Update(70, false, kStart + 10min);
+    estimator.Update(60, false, kStart + 20min);
+    ASSERT_TRUE(estimator.GetTimeToEmpty().has_value());
+
+    estimator.Update(Battery{}, false, kStart + 25min);
+    EXPECT_FALSE(estimator.GetTimeToEmpty().has_value());
+
+    estimator.Update(50, false, kStart + 30min);
+    estimator.Update(40, false, kStart + 40min);
+    EXPECT_FALSE(estimator.GetTimeToEmpty().has_value());
+}
+
+TEST(DrainEstimator, IgnoresStepsInTheWrongDirection)
+{
+    DrainEstimator estimator;
+
+    estimator.Update(80, false, kStart);
+    estimator.Update(70, false, kStart + 10min);
+
+    // Neither the step up nor the next step down is measured, as the step down doesn't start
+    // from a step seen entirely
+    //
+    estimator.Update(80, false, kStart + 15min);
+    estimator.Update(70, false, kStart + 25min);
+    EXPECT_FALSE(estimator.GetTimeToEmpty().has_value());
+
+    estimator.Update(60, false, kStart + 35min);
+    ExpectSeconds(estimator.GetTimeToEmpty(), 60min);
+
+    // A step up doesn't change the rate
+    //
+    estimator.Update(70, false, kStart + 40min);
+    ExpectSeconds(estimator.GetTimeToEmpty(), 70min);
+}
+
+TEST(DrainEstimator, ClampsTimeToFullAt100)
+{
+    DrainEstimator estimator;
+
+    estimator.Update(80, true, kStart);
+    estimator.Update(90, true, kStart + 10min);
+    estimator.Update(100, true, kStart + 20min);
+    ExpectSeconds(estimator.GetTimeToFull(), 0s);
+
+    estimator.Update(110, true, kStart + 30min);
+    ExpectSeconds(estimator.GetTimeToFull(), 0s);
+}